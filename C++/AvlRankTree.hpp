@@ -38,6 +38,10 @@ private:
     AvlNode *_root;
     int _size;
 
+#ifdef AVL_RANK_TREE_STATS
+    long _rotations = 0;
+#endif
+
     static AvlNode **getSortedNodesArray(AvlNode **nodesArray, AvlNode *node);
 
     AvlNode *getNodeByKey(K key);
@@ -64,9 +68,9 @@ private:
 
     void destroy(AvlNode *node);
 
-    void parentPointTo(AvlNode *child, AvlNode *newChild);
+    void release(AvlNode *node);
 
-    void setTreeFromSortedNodes(K *sortedKeysArray, V **sortedDataArray, int length);
+    void parentPointTo(AvlNode *child, AvlNode *newChild);
 
     static int getMergedSize(AvlNode **nodes1, int size1, AvlNode **nodes2, int size2);
 
@@ -75,8 +79,35 @@ private:
                    int mergedSize);
 
 public:
+    // In-order iterator, walks the nodes through their parent links without allocating.
+    class Iterator {
+    private:
+        AvlNode *_node;
+
+        explicit Iterator(AvlNode *node) : _node(node) {}
+
+        friend class AVLRankTree;
+
+    public:
+        Iterator() : _node(nullptr) {}
+
+        Iterator &operator++();
+
+        bool operator==(const Iterator &it) const { return _node == it._node; }
+
+        bool operator!=(const Iterator &it) const { return _node != it._node; }
+
+        const K &key() const { return _node->_key; }
+
+        V *value() const { return _node->_value; }
+    };
+
     AVLRankTree() : _root(nullptr), _size(0) {}
 
+    Iterator begin();
+
+    Iterator end() { return Iterator(); }
+
     virtual ~AVLRankTree();
 
     void insert(K key, V *data);
@@ -87,8 +118,25 @@ public:
 
     void destroy();
 
+    // Frees the tree nodes but not the values, the caller keeps ownership of them.
+    void release();
+
+    // Replaces the tree with one built in O(n) from strictly increasing keys, the tree owns the values.
+    void setTreeFromSortedNodes(K *sortedKeysArray, V **sortedDataArray, int length);
+
     int getSize();
 
+    // Height of the root, the longest search path.
+    int getHeight() { return _root ? _root->_height : 0; }
+
+    // Bytes allocated per entry by the tree (values excluded).
+    static size_t getNodeBytes() { return sizeof(AvlNode); }
+
+#ifdef AVL_RANK_TREE_STATS
+    // Single rotations done since the tree was created.
+    long getRotations() { return _rotations; }
+#endif
+
     int isEmpty();
 
     bool includes(K key);
@@ -97,6 +145,16 @@ public:
 
     V *getValue(K key);
 
+    // Value of the key, or nullptr when it doesn't exist.
+    V *find(K key);
+
+    // Hints the CPU to load the root node, before a search.
+    void prefetchRoot() {
+#if defined(__GNUC__)
+        if (_root) __builtin_prefetch(_root);
+#endif
+    }
+
     V **getValueSorted();
 
     // Tree values have to overload operator +.
@@ -125,6 +183,33 @@ void AVLRankTree<K, V>::destroy() {
     _root = nullptr;
 }
 
+template<class K, class V>
+typename AVLRankTree<K, V>::Iterator AVLRankTree<K, V>::begin() {
+    auto node = _root;
+    while (node && node->_left) node = node->_left;
+    return Iterator(node);
+}
+
+template<class K, class V>
+typename AVLRankTree<K, V>::Iterator &AVLRankTree<K, V>::Iterator::operator++() {
+    if (_node->_right) {
+        _node = _node->_right;
+        while (_node->_left) _node = _node->_left;
+        return *this;
+    }
+    while (_node->_parent && _node->_parent->_right == _node) _node = _node->_parent;
+    _node = _node->_parent;
+    return *this;
+}
+
+template<class K, class V>
+void AVLRankTree<K, V>::release() {
+    release(_root);
+
+    _size = 0;
+    _root = nullptr;
+}
+
 template<class K, class V>
 void AVLRankTree<K, V>::setTreeFromSortedNodes(K *sortedKeysArray, V **sortedDataArray, int length) {
     for (int i = 0; i < length - 1; i++) if (!(sortedKeysArray[i] < sortedKeysArray[i + 1])) throw AvlIllegalInput();
@@ -194,6 +279,12 @@ V *AVLRankTree<K, V>::getValue(K key) {
     return node->_value;
 }
 
+template<class K, class V>
+V *AVLRankTree<K, V>::find(K key) {
+    AvlNode *node = getNodeByKey(key);
+    return node ? node->_value : nullptr;
+}
+
 template<class K, class V>
 bool AVLRankTree<K, V>::includes(K key) {
     return getNodeByKey(key) != nullptr;
@@ -305,6 +396,9 @@ void AVLRankTree<K, T>::balance(AvlNode *node) {
 
 template<class K, class T>
 void AVLRankTree<K, T>::llRotation(AvlNode *node) {
+#ifdef AVL_RANK_TREE_STATS
+    _rotations++;
+#endif
     auto parent = node->_parent;
     auto left = node->_left;
 
@@ -325,6 +419,9 @@ void AVLRankTree<K, T>::llRotation(AvlNode *node) {
 
 template<class K, class T>
 void AVLRankTree<K, T>::rrRotation(AvlNode *node) {
+#ifdef AVL_RANK_TREE_STATS
+    _rotations++;
+#endif
     auto parent = node->_parent;
     auto right = node->_right;
 
@@ -412,6 +509,14 @@ void AVLRankTree<K, T>::destroy(AvlNode *node) {
     delete node;
 }
 
+template<class K, class T>
+void AVLRankTree<K, T>::release(AvlNode *node) {
+    if (node == nullptr) return;
+    release(node->_left);
+    release(node->_right);
+    delete node;
+}
+
 template<class K, class T>
 typename AVLRankTree<K, T>::AvlNode *
 AVLRankTree<K, T>::treeFromSortedNodes(K *sortedKeysArray, T **sortedDataArray, int length, AvlNode *parent) {
@@ -441,7 +546,7 @@ AVLRankTree<K, T>::treeFromSortedNodes(K *sortedKeysArray, T **sortedDataArray,
 
     else if (!node->_right) node->_height = node->_left->_height + 1;
 
-    else node->_height = (node->_left->_height > node->_right->_height) ? node->_left->_height : node->_right->_height;
+    else node->_height = ((node->_left->_height > node->_right->_height) ? node->_left->_height : node->_right->_height) + 1;
 
     return node;
 }
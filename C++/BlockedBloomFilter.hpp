@@ -0,0 +1,115 @@
+#ifndef BlockedBloomFilter_H_
+#define BlockedBloomFilter_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <exception>
+
+#define BLOOM_BLOCK_BITS 512
+#define BLOOM_MAX_HASHES 16
+
+using namespace std;
+
+class BloomIllegalInput : public exception {
+};
+
+/**
+ * Bloom filter over 64 bit hash codes, blocked: all the bits of a key are in one
+ * 64 byte block, so a query touches a single cache line.
+ * The code is remixed first (splitmix64 finalizer): integer codes from HashMix are a
+ * single multiply, keys in an arithmetic progression would otherwise crowd a few blocks.
+ * The high half of the remixed code picks the block, the low half is multiplied by
+ * a salt per probed bit.
+ */
+class BlockedBloomFilter {
+private:
+    struct alignas(64) Block {
+        uint64_t _words[BLOOM_BLOCK_BITS / 64];
+    };
+
+    Block *_blocks;
+    uint64_t _blockCount;
+    int _hashes;
+
+    static uint32_t salt(int i) {
+        static const uint32_t salts[BLOOM_MAX_HASHES] = {
+                0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU, 0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+                0x3c6ef373U, 0xbb67ae85U, 0xa54ff53bU, 0x510e527fU, 0x9b05688bU, 0x1f83d9abU, 0x5be0cd19U, 0xcbbb9d5dU
+        };
+        return salts[i];
+    }
+
+    static uint64_t remix(uint64_t hash) {
+        hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+        return hash ^ (hash >> 31);
+    }
+
+    const Block &blockOf(uint64_t hash) const { return _blocks[((hash >> 32) * _blockCount) >> 32]; }
+
+    // Bit of the block set by the i'th probe, from the top 9 bits of the salted low half.
+    static int bitOf(uint64_t hash, int i) { return (int) (((uint32_t) hash * salt(i)) >> 23); }
+
+public:
+    /**
+     * @param capacity - keys the filter is sized for, more keys raise the false positive rate.
+     * @param falsePositiveRate - in (0, 1), sets the number of probed bits and the bits per key.
+     */
+    BlockedBloomFilter(int capacity, double falsePositiveRate);
+
+    BlockedBloomFilter(const BlockedBloomFilter &) = delete;
+
+    BlockedBloomFilter &operator=(const BlockedBloomFilter &) = delete;
+
+    ~BlockedBloomFilter() { delete[] _blocks; }
+
+    void add(uint64_t hash);
+
+    // False means the key was never added, true may be a false positive.
+    bool mayContain(uint64_t hash) const;
+
+    void clear();
+
+    long getBytes() const { return (long) (_blockCount * sizeof(Block)); }
+};
+
+inline BlockedBloomFilter::BlockedBloomFilter(int capacity, double falsePositiveRate) {
+    if (capacity < 0 || !(falsePositiveRate > 0 && falsePositiveRate < 1)) throw BloomIllegalInput();
+
+    int hashes = (int) lround(-log2(falsePositiveRate));
+    _hashes = hashes < 1 ? 1 : hashes > BLOOM_MAX_HASHES ? BLOOM_MAX_HASHES : hashes;
+    // k / ln2 bits per key is optimal for a plain filter, blocking skews the load between
+    // blocks, so give a bit more the more bits a key sets.
+    double bitsPerKey = _hashes / log(2.0) * (1 + _hashes / 64.0);
+    _blockCount = (uint64_t) ceil(capacity * bitsPerKey / BLOOM_BLOCK_BITS);
+    if (_blockCount == 0) _blockCount = 1;
+
+    _blocks = new Block[_blockCount];
+    clear();
+}
+
+inline void BlockedBloomFilter::add(uint64_t hash) {
+    hash = remix(hash);
+    auto &block = const_cast<Block &>(blockOf(hash));
+    for (int i = 0; i < _hashes; ++i) {
+        int bit = bitOf(hash, i);
+        block._words[bit >> 6] |= 1ULL << (bit & 63);
+    }
+}
+
+inline bool BlockedBloomFilter::mayContain(uint64_t hash) const {
+    hash = remix(hash);
+    auto &block = blockOf(hash);
+    for (int i = 0; i < _hashes; ++i) {
+        int bit = bitOf(hash, i);
+        if (!(block._words[bit >> 6] & (1ULL << (bit & 63)))) return false;
+    }
+    return true;
+}
+
+inline void BlockedBloomFilter::clear() {
+    memset(_blocks, 0, _blockCount * sizeof(Block));
+}
+
+#endif /* BlockedBloomFilter_H_ */
@@ -0,0 +1,377 @@
+#ifndef CompactHashTable_H_
+#define CompactHashTable_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <new>
+#include <utility>
+#include "HashTable.hpp"
+
+#define COMPACT_EMPTY (-1)
+#define COMPACT_DUMMY (-2)
+#define COMPACT_MIN_INDEX 8
+#define COMPACT_PERTURB_SHIFT 5
+
+/**
+ * Insertion ordered hash table with the compact layout of Python's dict.
+ * The entries (hash code, key, value) are appended to a dense array, a separate open
+ * addressed index holds entry positions in 8, 16 or 32 bit slots, the narrowest that fits.
+ *
+ * Iteration is a linear scan of the entries in insertion order. A removed entry leaves
+ * a hole (and a dummy index slot) until the next resize, which drops the holes and
+ * rebuilds the index from the cached hash codes; no key is hashed or compared again.
+ * Entries move on resize, pointers to them are valid until the next insert.
+ */
+template<class V, class K = int, class Hash = HashMix<K>, class Eq = equal_to<>>
+class CompactHashTable {
+private:
+    struct Entry {
+        uint64_t _hash;
+        bool _live;
+        K _key;
+        V _value;
+    };
+
+    Entry *_entries;
+    int _entryCount; // Appended entries, holes included.
+    int _entryCapacity;
+    int _counter;
+
+    unsigned char *_index;
+    int _indexSize; // Power of two.
+    int _width; // Bytes per index slot.
+
+    Hash _hash;
+    Eq _eq;
+
+    template<class Q>
+    uint64_t hashOf(const Q &key) const { return (uint64_t) _hash(key); }
+
+    static int usableFor(int indexSize) { return indexSize * 2 / 3; }
+
+    int slotAt(int i) const;
+
+    void setSlot(int i, int entry);
+
+    // Index slot of the key, or -1. entry is set to the position of its entry.
+    template<class Q>
+    int findSlot(const Q &key, uint64_t hash, int &entry) const;
+
+    int emptySlot(uint64_t hash) const;
+
+    void resize(int minEntries);
+
+    void destroyEntries();
+
+public:
+    explicit CompactHashTable(const Hash &hash = Hash(), const Eq &eq = Eq());
+
+    explicit CompactHashTable(int initial_size, const Hash &hash = Hash(), const Eq &eq = Eq());
+
+    CompactHashTable(const CompactHashTable &) = delete;
+
+    CompactHashTable &operator=(const CompactHashTable &) = delete;
+
+    ~CompactHashTable();
+
+    // Resizes once so n entries fit without any further growth.
+    void reserve(int n);
+
+    void insert(const K &key, const V &value);
+
+    void insert(const K &key, V &&value);
+
+    // Constructs the value in place from args, throws AvlKeyAlreadyExists when the key exists.
+    template<class... Args>
+    void emplace(const K &key, Args &&... args);
+
+    template<class Q>
+    V getValue(const Q &key);
+
+    // Pointer to the value of the key, or nullptr. Valid until the next insert.
+    template<class Q>
+    V *find(const Q &key);
+
+    template<class Q>
+    bool includesKey(const Q &key);
+
+    template<class Q>
+    void remove(const Q &key);
+
+    bool isEmpty();
+
+    // Number of index slots.
+    int getSize();
+
+    int getCount();
+
+    // Bytes of the entries array and the index.
+    long getBytes();
+
+    void clear();
+
+    // Forward iterator in insertion order, *it is a pair (key, value reference).
+    class Iterator {
+    private:
+        CompactHashTable *_table;
+        int _position;
+
+        Iterator(CompactHashTable *table, int position) : _table(table), _position(position) {}
+
+        void settle() {
+            while (_position < _table->_entryCount && !_table->_entries[_position]._live) _position++;
+        }
+
+        friend class CompactHashTable;
+
+    public:
+        pair<const K &, V &> operator*() const {
+            auto &entry = _table->_entries[_position];
+            return pair<const K &, V &>(entry._key, entry._value);
+        }
+
+        Iterator &operator++() {
+            ++_position;
+            settle();
+            return *this;
+        }
+
+        bool operator==(const Iterator &it) const { return _position == it._position; }
+
+        bool operator!=(const Iterator &it) const { return _position != it._position; }
+    };
+
+    Iterator begin();
+
+    Iterator end();
+
+    // Calls f(key, value) for every entry, in insertion order.
+    template<class F>
+    void forEach(F f);
+};
+
+template<class V, class K, class Hash, class Eq>
+CompactHashTable<V, K, Hash, Eq>::CompactHashTable(const Hash &hash, const Eq &eq)
+        : _entries(nullptr), _entryCount(0), _entryCapacity(0), _counter(EMPTY_SIZE),
+          _index(nullptr), _indexSize(0), _width(1), _hash(hash), _eq(eq) {
+    resize(0);
+}
+
+template<class V, class K, class Hash, class Eq>
+CompactHashTable<V, K, Hash, Eq>::CompactHashTable(int initial_size, const Hash &hash, const Eq &eq)
+        : CompactHashTable(hash, eq) {
+    reserve(initial_size);
+}
+
+template<class V, class K, class Hash, class Eq>
+CompactHashTable<V, K, Hash, Eq>::~CompactHashTable() {
+    destroyEntries();
+    operator delete(_entries);
+    delete[] _index;
+}
+
+template<class V, class K, class Hash, class Eq>
+int CompactHashTable<V, K, Hash, Eq>::slotAt(int i) const {
+    switch (_width) {
+        case 1:
+            return reinterpret_cast<const int8_t *>(_index)[i];
+        case 2:
+            return reinterpret_cast<const int16_t *>(_index)[i];
+        default:
+            return reinterpret_cast<const int32_t *>(_index)[i];
+    }
+}
+
+template<class V, class K, class Hash, class Eq>
+void CompactHashTable<V, K, Hash, Eq>::setSlot(int i, int entry) {
+    switch (_width) {
+        case 1:
+            reinterpret_cast<int8_t *>(_index)[i] = (int8_t) entry;
+            break;
+        case 2:
+            reinterpret_cast<int16_t *>(_index)[i] = (int16_t) entry;
+            break;
+        default:
+            reinterpret_cast<int32_t *>(_index)[i] = (int32_t) entry;
+    }
+}
+
+// Python's probe sequence: i = 5i + 1 + perturb, with the high bits of the hash shifted in.
+template<class V, class K, class Hash, class Eq>
+template<class Q>
+int CompactHashTable<V, K, Hash, Eq>::findSlot(const Q &key, uint64_t hash, int &entry) const {
+    uint64_t mask = _indexSize - 1, perturb = hash;
+    for (uint64_t i = hash & mask;; i = (i * 5 + perturb + 1) & mask) {
+        int ix = slotAt((int) i);
+        if (ix == COMPACT_EMPTY) return -1;
+        if (ix >= 0 && _entries[ix]._hash == hash && _eq(_entries[ix]._key, key)) {
+            entry = ix;
+            return (int) i;
+        }
+        perturb >>= COMPACT_PERTURB_SHIFT;
+    }
+}
+
+template<class V, class K, class Hash, class Eq>
+int CompactHashTable<V, K, Hash, Eq>::emptySlot(uint64_t hash) const {
+    uint64_t mask = _indexSize - 1, perturb = hash;
+    for (uint64_t i = hash & mask;; i = (i * 5 + perturb + 1) & mask) {
+        if (slotAt((int) i) == COMPACT_EMPTY) return (int) i;
+        perturb >>= COMPACT_PERTURB_SHIFT;
+    }
+}
+
+// New index for at least minEntries live entries, the live entries are compacted in order.
+template<class V, class K, class Hash, class Eq>
+void CompactHashTable<V, K, Hash, Eq>::resize(int minEntries) {
+    int indexSize = COMPACT_MIN_INDEX;
+    while (usableFor(indexSize) < minEntries) indexSize *= 2;
+    int capacity = usableFor(indexSize);
+
+    auto entries = static_cast<Entry *>(operator new(sizeof(Entry) * capacity));
+    int count = 0;
+    for (int i = 0; i < _entryCount; ++i) {
+        if (!_entries[i]._live) continue;
+        new(&entries[count++]) Entry{_entries[i]._hash, true, std::move(_entries[i]._key),
+                                     std::move(_entries[i]._value)};
+    }
+    destroyEntries();
+    operator delete(_entries);
+    delete[] _index;
+
+    _entries = entries;
+    _entryCount = count;
+    _entryCapacity = capacity;
+    _indexSize = indexSize;
+    _width = indexSize <= 128 ? 1 : indexSize <= (1 << 15) ? 2 : 4;
+    _index = new unsigned char[(size_t) _indexSize * _width];
+    memset(_index, 0xFF, (size_t) _indexSize * _width); // COMPACT_EMPTY in every width
+
+    for (int i = 0; i < _entryCount; ++i) setSlot(emptySlot(_entries[i]._hash), i);
+}
+
+template<class V, class K, class Hash, class Eq>
+void CompactHashTable<V, K, Hash, Eq>::destroyEntries() {
+    for (int i = 0; i < _entryCount; ++i) {
+        if (!_entries[i]._live) continue;
+        _entries[i]._key.~K();
+        _entries[i]._value.~V();
+    }
+    _entryCount = 0;
+}
+
+template<class V, class K, class Hash, class Eq>
+void CompactHashTable<V, K, Hash, Eq>::reserve(int n) {
+    if (n < 0) throw HashIllegalInput();
+    if (n > _entryCapacity) resize(n);
+}
+
+template<class V, class K, class Hash, class Eq>
+void CompactHashTable<V, K, Hash, Eq>::insert(const K &key, const V &value) {
+    emplace(key, value);
+}
+
+template<class V, class K, class Hash, class Eq>
+void CompactHashTable<V, K, Hash, Eq>::insert(const K &key, V &&value) {
+    emplace(key, std::move(value));
+}
+
+template<class V, class K, class Hash, class Eq>
+template<class... Args>
+void CompactHashTable<V, K, Hash, Eq>::emplace(const K &key, Args &&... args) {
+    uint64_t hash = hashOf(key);
+    int entry;
+    if (findSlot(key, hash, entry) >= 0) throw AvlKeyAlreadyExists();
+
+    // Full: grow when mostly live, otherwise the resize only drops the holes.
+    if (_entryCount == _entryCapacity) resize(_counter * 2 > _entryCapacity ? _counter * 2 + 1 : _counter + 1);
+
+    new(&_entries[_entryCount]) Entry{hash, true, key, V(std::forward<Args>(args)...)};
+    setSlot(emptySlot(hash), _entryCount);
+    _entryCount++;
+    _counter++;
+}
+
+template<class V, class K, class Hash, class Eq>
+template<class Q>
+V *CompactHashTable<V, K, Hash, Eq>::find(const Q &key) {
+    int entry;
+    return findSlot(key, hashOf(key), entry) >= 0 ? &_entries[entry]._value : nullptr;
+}
+
+template<class V, class K, class Hash, class Eq>
+template<class Q>
+V CompactHashTable<V, K, Hash, Eq>::getValue(const Q &key) {
+    auto value = find(key);
+    if (!value) throw HashKeyDoesNotExist();
+    return *value;
+}
+
+template<class V, class K, class Hash, class Eq>
+template<class Q>
+bool CompactHashTable<V, K, Hash, Eq>::includesKey(const Q &key) {
+    return find(key) != nullptr;
+}
+
+template<class V, class K, class Hash, class Eq>
+template<class Q>
+void CompactHashTable<V, K, Hash, Eq>::remove(const Q &key) {
+    int entry;
+    int slot = findSlot(key, hashOf(key), entry);
+    if (slot < 0) return;
+
+    setSlot(slot, COMPACT_DUMMY);
+    _entries[entry]._key.~K();
+    _entries[entry]._value.~V();
+    _entries[entry]._live = false;
+    _counter--;
+}
+
+template<class V, class K, class Hash, class Eq>
+bool CompactHashTable<V, K, Hash, Eq>::isEmpty() {
+    return _counter == EMPTY_SIZE;
+}
+
+template<class V, class K, class Hash, class Eq>
+int CompactHashTable<V, K, Hash, Eq>::getSize() {
+    return _indexSize;
+}
+
+template<class V, class K, class Hash, class Eq>
+int CompactHashTable<V, K, Hash, Eq>::getCount() {
+    return _counter;
+}
+
+template<class V, class K, class Hash, class Eq>
+long CompactHashTable<V, K, Hash, Eq>::getBytes() {
+    return (long) _entryCapacity * (long) sizeof(Entry) + (long) _indexSize * _width;
+}
+
+template<class V, class K, class Hash, class Eq>
+void CompactHashTable<V, K, Hash, Eq>::clear() {
+    destroyEntries();
+    _counter = EMPTY_SIZE;
+    resize(0);
+}
+
+template<class V, class K, class Hash, class Eq>
+typename CompactHashTable<V, K, Hash, Eq>::Iterator CompactHashTable<V, K, Hash, Eq>::begin() {
+    Iterator it(this, 0);
+    it.settle();
+    return it;
+}
+
+template<class V, class K, class Hash, class Eq>
+typename CompactHashTable<V, K, Hash, Eq>::Iterator CompactHashTable<V, K, Hash, Eq>::end() {
+    return Iterator(this, _entryCount);
+}
+
+template<class V, class K, class Hash, class Eq>
+template<class F>
+void CompactHashTable<V, K, Hash, Eq>::forEach(F f) {
+    for (int i = 0; i < _entryCount; ++i) {
+        if (_entries[i]._live) f(_entries[i]._key, _entries[i]._value);
+    }
+}
+
+#endif /* CompactHashTable_H_ */
@@ -0,0 +1,156 @@
+#ifndef ConcurrentHashTable_H_
+#define ConcurrentHashTable_H_
+
+#include <stdint.h>
+#include <functional>
+#include <shared_mutex>
+#include <mutex>
+#include "HashTable.hpp"
+
+#define DEFAULT_SHARDS 16
+
+class ConcurrentHashIllegalInput : public exception {
+};
+
+/**
+ * Thread-safe hash table, built from independent HashTable shards.
+ * Every shard has its own reader-writer lock and resizes on its own,
+ * getValue/includesKey take the shard lock shared, insert/remove take it exclusive.
+ *
+ * The shard is picked from the high bits of (uint32_t) key * 0x9E3779B97F4A7C15, the bucket
+ * inside the shard from the high bits of HashMix(key), a multiply by HASH_MIX_P0. Measured
+ * independent: buckets spread inside the shards as they do when the shard is picked at random.
+ */
+template<class V>
+class ConcurrentHashTable {
+private:
+    // Shards are many and usually hold many entries, no inline storage in every one of them.
+    typedef HashTable<V, int, HashMix<int>, equal_to<>, 0> ShardTable;
+
+    // A shard per cache line, so locking one shard doesn't invalidate its neighbours.
+    struct alignas(64) Shard {
+        shared_mutex _lock;
+        ShardTable *_table;
+    };
+
+    Shard *_shards;
+    int _shardBits;
+
+    Shard &shardOf(int key);
+
+public:
+    /**
+     * @param shards - number of shards, rounded up to a power of two.
+     * @param initial_size - expected entries per shard.
+     */
+    explicit ConcurrentHashTable(int shards = DEFAULT_SHARDS, int initial_size = EMPTY_SIZE);
+
+    ConcurrentHashTable(const ConcurrentHashTable &) = delete;
+
+    ConcurrentHashTable &operator=(const ConcurrentHashTable &) = delete;
+
+    ~ConcurrentHashTable();
+
+    V getValue(int key);
+
+    void insert(int key, V value);
+
+    void remove(int key);
+
+    bool includesKey(int key);
+
+    int getShardCount();
+
+    // Sum of the shards' counts, every shard is read under its own lock (not a global snapshot).
+    int getCount();
+
+    /**
+     * Calls f(key, value) for every entry, one shard at a time under its shared lock.
+     * f must not call back into the table.
+     */
+    template<class F>
+    void forEach(F f);
+};
+
+template<class V>
+ConcurrentHashTable<V>::ConcurrentHashTable(int shards, int initial_size) {
+    if (shards <= 0) throw ConcurrentHashIllegalInput();
+    _shardBits = 0;
+    while ((1 << _shardBits) < shards) _shardBits++;
+
+    _shards = new Shard[1 << _shardBits];
+    for (int i = 0; i < (1 << _shardBits); ++i) {
+        _shards[i]._table = initial_size > 0 ? new ShardTable(initial_size) : new ShardTable();
+    }
+}
+
+template<class V>
+ConcurrentHashTable<V>::~ConcurrentHashTable() {
+    typename ShardTable::ValueDestroyFunction keep;
+    for (int i = 0; i < getShardCount(); ++i) {
+        _shards[i]._table->destroyHash(&keep);
+        delete _shards[i]._table;
+    }
+    delete[] _shards;
+}
+
+template<class V>
+typename ConcurrentHashTable<V>::Shard &ConcurrentHashTable<V>::shardOf(int key) {
+    if (_shardBits == 0) return _shards[0];
+    uint64_t h = (uint32_t) key * 0x9E3779B97F4A7C15ULL;
+    return _shards[h >> (64 - _shardBits)];
+}
+
+template<class V>
+V ConcurrentHashTable<V>::getValue(int key) {
+    auto &shard = shardOf(key);
+    shared_lock<shared_mutex> lock(shard._lock);
+    return shard._table->getValue(key);
+}
+
+template<class V>
+void ConcurrentHashTable<V>::insert(int key, V value) {
+    auto &shard = shardOf(key);
+    unique_lock<shared_mutex> lock(shard._lock);
+    shard._table->insert(key, std::move(value));
+}
+
+template<class V>
+void ConcurrentHashTable<V>::remove(int key) {
+    auto &shard = shardOf(key);
+    unique_lock<shared_mutex> lock(shard._lock);
+    shard._table->remove(key);
+}
+
+template<class V>
+bool ConcurrentHashTable<V>::includesKey(int key) {
+    auto &shard = shardOf(key);
+    shared_lock<shared_mutex> lock(shard._lock);
+    return shard._table->includesKey(key);
+}
+
+template<class V>
+int ConcurrentHashTable<V>::getShardCount() {
+    return 1 << _shardBits;
+}
+
+template<class V>
+int ConcurrentHashTable<V>::getCount() {
+    int count = 0;
+    for (int i = 0; i < getShardCount(); ++i) {
+        shared_lock<shared_mutex> lock(_shards[i]._lock);
+        count += _shards[i]._table->getCount();
+    }
+    return count;
+}
+
+template<class V>
+template<class F>
+void ConcurrentHashTable<V>::forEach(F f) {
+    for (int i = 0; i < getShardCount(); ++i) {
+        shared_lock<shared_mutex> lock(_shards[i]._lock);
+        _shards[i]._table->forEach(ref(f));
+    }
+}
+
+#endif /* ConcurrentHashTable_H_ */
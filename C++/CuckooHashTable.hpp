@@ -0,0 +1,399 @@
+#ifndef CuckooHashTable_H_
+#define CuckooHashTable_H_
+
+#include <stdint.h>
+#include <new>
+#include <utility>
+#include "HashTable.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define CUCKOO_WAYS 4
+#define CUCKOO_STASH_SIZE 4
+#define CUCKOO_BFS_NODES 256
+#define CUCKOO_MAX_LOAD 0.9
+
+/**
+ * Bucketized cuckoo hash table, same API as HashTable.
+ * Every key may live in one of its two buckets (4 slots each) or in a small stash,
+ * so a lookup is bounded: two buckets (a cache line each for values up to 8 bytes),
+ * plus the stash only while it's not empty.
+ *
+ * A full insert frees a slot by moving keys to their other bucket along the shortest
+ * path found by a BFS, falls back to the stash, and rehashes to a bigger table only
+ * when the stash is full as well.
+ */
+template<class V>
+class CuckooHashTable {
+private:
+    struct alignas(64) Bucket {
+        int _keys[CUCKOO_WAYS];
+        uint8_t _occupied;
+        alignas(V) unsigned char _values[CUCKOO_WAYS * sizeof(V)];
+
+        V *value(int slot) { return reinterpret_cast<V *>(_values) + slot; }
+    };
+
+    struct Path {
+        int _bucket;
+        int _parent;
+        int _slot;
+    };
+
+    Bucket *_buckets;
+    int _bucketCount;
+    int _counter;
+
+    int _stashKeys[CUCKOO_STASH_SIZE];
+    V *_stash[CUCKOO_STASH_SIZE];
+    int _stashCount;
+
+    static uint64_t mix(int key);
+
+    void bucketsOf(int key, int &first, int &second);
+
+    static int matchMask(Bucket *bucket, int key);
+
+    V *findValue(int key);
+
+    template<class T>
+    bool place(int key, T &&value);
+
+    bool displace(int first, int second, int &bucket, int &slot);
+
+    void moveSlot(int from, int fromSlot, int to, int toSlot);
+
+    static Bucket *allocate(int bucketCount);
+
+    static void destroyBuckets(Bucket *buckets, int bucketCount);
+
+    void release();
+
+    void rehash(int bucketCount);
+
+public:
+
+    class ValueDestroyFunction {
+    public:
+        virtual void operator()(V) {}
+    };
+
+    CuckooHashTable() : CuckooHashTable(EMPTY_SIZE) {}
+
+    explicit CuckooHashTable(int initial_size);
+
+    CuckooHashTable(const CuckooHashTable &) = delete;
+
+    CuckooHashTable &operator=(const CuckooHashTable &) = delete;
+
+    ~CuckooHashTable() { release(); }
+
+    V getValue(int key);
+
+    int hashFunction(int key);
+
+    void insert(int key, V value);
+
+    void remove(int key);
+
+    bool includesKey(int key);
+
+    bool isEmpty();
+
+    int getSize();
+
+    int getCount();
+
+    void destroyHash(ValueDestroyFunction *f);
+};
+
+template<class V>
+CuckooHashTable<V>::CuckooHashTable(int initial_size) : _counter(EMPTY_SIZE), _stashCount(0) {
+    _bucketCount = 2;
+    while (_bucketCount * CUCKOO_WAYS * CUCKOO_MAX_LOAD < initial_size) _bucketCount *= 2;
+    _buckets = allocate(_bucketCount);
+}
+
+template<class V>
+typename CuckooHashTable<V>::Bucket *CuckooHashTable<V>::allocate(int bucketCount) {
+    auto buckets = new Bucket[bucketCount];
+    for (int i = 0; i < bucketCount; ++i) buckets[i]._occupied = 0;
+    return buckets;
+}
+
+template<class V>
+void CuckooHashTable<V>::destroyBuckets(Bucket *buckets, int bucketCount) {
+    for (int b = 0; b < bucketCount; ++b) {
+        for (int s = 0; s < CUCKOO_WAYS; ++s) {
+            if (buckets[b]._occupied & (1 << s)) buckets[b].value(s)->~V();
+        }
+    }
+    delete[] buckets;
+}
+
+template<class V>
+void CuckooHashTable<V>::release() {
+    if (_buckets == nullptr) return;
+    destroyBuckets(_buckets, _bucketCount);
+    for (int i = 0; i < _stashCount; ++i) delete _stash[i];
+    _buckets = nullptr;
+    _stashCount = 0;
+    _counter = EMPTY_SIZE;
+}
+
+template<class V>
+uint64_t CuckooHashTable<V>::mix(int key) {
+    uint64_t h = (uint32_t) key;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// Two independent halves of the hash, forced apart when they collide.
+template<class V>
+void CuckooHashTable<V>::bucketsOf(int key, int &first, int &second) {
+    uint64_t h = mix(key);
+    int mask = _bucketCount - 1;
+    first = (int) (h & mask);
+    second = (int) ((h >> 32) & mask);
+    if (second == first) second = first ^ 1;
+}
+
+template<class V>
+int CuckooHashTable<V>::matchMask(Bucket *bucket, int key) {
+#ifdef __SSE2__
+    __m128i keys = _mm_load_si128(reinterpret_cast<const __m128i *>(bucket->_keys));
+    __m128i match = _mm_cmpeq_epi32(keys, _mm_set1_epi32(key));
+    return _mm_movemask_ps(_mm_castsi128_ps(match)) & bucket->_occupied;
+#else
+    int mask = 0;
+    for (int s = 0; s < CUCKOO_WAYS; ++s) {
+        if (bucket->_keys[s] == key) mask |= 1 << s;
+    }
+    return mask & bucket->_occupied;
+#endif
+}
+
+template<class V>
+V *CuckooHashTable<V>::findValue(int key) {
+    int first, second;
+    bucketsOf(key, first, second);
+
+    int mask = matchMask(&_buckets[first], key);
+    if (mask) return _buckets[first].value(__builtin_ctz(mask));
+    mask = matchMask(&_buckets[second], key);
+    if (mask) return _buckets[second].value(__builtin_ctz(mask));
+
+    for (int i = 0; i < _stashCount; ++i) {
+        if (_stashKeys[i] == key) return _stash[i];
+    }
+    return nullptr;
+}
+
+template<class V>
+void CuckooHashTable<V>::moveSlot(int from, int fromSlot, int to, int toSlot) {
+    Bucket &source = _buckets[from];
+    Bucket &target = _buckets[to];
+    target._keys[toSlot] = source._keys[fromSlot];
+    new(target.value(toSlot)) V(std::move(*source.value(fromSlot)));
+    source.value(fromSlot)->~V();
+    target._occupied |= 1 << toSlot;
+    source._occupied &= ~(1 << fromSlot);
+}
+
+/**
+ * BFS over the displacement graph for the closest bucket with a free slot,
+ * then moves the keys along the path back to first/second.
+ * @return false when no path exists within CUCKOO_BFS_NODES buckets.
+ */
+template<class V>
+bool CuckooHashTable<V>::displace(int first, int second, int &bucket, int &slot) {
+    Path nodes[CUCKOO_BFS_NODES];
+    int count = 0;
+    nodes[count++] = Path{first, -1, -1};
+    nodes[count++] = Path{second, -1, -1};
+
+    for (int head = 0; head < count; ++head) {
+        int current = nodes[head]._bucket;
+        for (int s = 0; s < CUCKOO_WAYS; ++s) {
+            int alternate, other;
+            bucketsOf(_buckets[current]._keys[s], alternate, other);
+            if (alternate == current) alternate = other;
+
+            if (_buckets[alternate]._occupied != (1 << CUCKOO_WAYS) - 1) {
+                moveSlot(current, s, alternate, __builtin_ctz(~_buckets[alternate]._occupied));
+
+                int free = s, n = head;
+                for (; nodes[n]._parent != -1; n = nodes[n]._parent) {
+                    moveSlot(nodes[nodes[n]._parent]._bucket, nodes[n]._slot, nodes[n]._bucket, free);
+                    free = nodes[n]._slot;
+                }
+                bucket = nodes[n]._bucket;
+                slot = free;
+                return true;
+            }
+
+            bool visited = false;
+            for (int n = 0; n < count && !visited; ++n) visited = nodes[n]._bucket == alternate;
+            if (!visited && count < CUCKOO_BFS_NODES) nodes[count++] = Path{alternate, head, s};
+        }
+    }
+    return false;
+}
+
+// Assumes the key is absent, false when neither a bucket slot nor the stash is free.
+template<class V>
+template<class T>
+bool CuckooHashTable<V>::place(int key, T &&value) {
+    int first, second;
+    bucketsOf(key, first, second);
+
+    int bucket = -1, slot = -1;
+    const int full = (1 << CUCKOO_WAYS) - 1;
+    if (_buckets[first]._occupied != full) {
+        bucket = first;
+    } else if (_buckets[second]._occupied != full) {
+        bucket = second;
+    }
+    if (bucket >= 0) slot = __builtin_ctz(~_buckets[bucket]._occupied);
+
+    if (bucket < 0 && !displace(first, second, bucket, slot)) {
+        if (_stashCount == CUCKOO_STASH_SIZE) return false;
+        _stashKeys[_stashCount] = key;
+        _stash[_stashCount++] = new V(std::forward<T>(value));
+        return true;
+    }
+
+    _buckets[bucket]._keys[slot] = key;
+    new(_buckets[bucket].value(slot)) V(std::forward<T>(value));
+    _buckets[bucket]._occupied |= 1 << slot;
+    return true;
+}
+
+// Rebuilds with bucketCount buckets, doubling again until every entry fits.
+template<class V>
+void CuckooHashTable<V>::rehash(int bucketCount) {
+    auto prevBuckets = _buckets;
+    int prevCount = _bucketCount;
+    int prevStashKeys[CUCKOO_STASH_SIZE];
+    V *prevStash[CUCKOO_STASH_SIZE];
+    int prevStashCount = _stashCount;
+    for (int i = 0; i < prevStashCount; ++i) {
+        prevStashKeys[i] = _stashKeys[i];
+        prevStash[i] = _stash[i];
+    }
+
+    // Entries are copied, the previous table stays intact until a size that fits is found.
+    for (;; bucketCount *= 2) {
+        _buckets = allocate(bucketCount);
+        _bucketCount = bucketCount;
+        _stashCount = 0;
+
+        bool fits = true;
+        for (int b = 0; b < prevCount && fits; ++b) {
+            for (int s = 0; s < CUCKOO_WAYS && fits; ++s) {
+                if (prevBuckets[b]._occupied & (1 << s)) {
+                    fits = place(prevBuckets[b]._keys[s], *prevBuckets[b].value(s));
+                }
+            }
+        }
+        for (int i = 0; i < prevStashCount && fits; ++i) fits = place(prevStashKeys[i], *prevStash[i]);
+        if (fits) break;
+
+        destroyBuckets(_buckets, _bucketCount);
+        for (int i = 0; i < _stashCount; ++i) delete _stash[i];
+    }
+
+    destroyBuckets(prevBuckets, prevCount);
+    for (int i = 0; i < prevStashCount; ++i) delete prevStash[i];
+}
+
+template<class V>
+int CuckooHashTable<V>::hashFunction(int key) {
+    int first, second;
+    bucketsOf(key, first, second);
+    return first;
+}
+
+template<class V>
+void CuckooHashTable<V>::insert(int key, V value) {
+    if (findValue(key)) throw AvlKeyAlreadyExists();
+
+    if ((_counter + 1) > _bucketCount * CUCKOO_WAYS * CUCKOO_MAX_LOAD) rehash(_bucketCount * 2);
+    while (!place(key, value)) rehash(_bucketCount * 2);
+    ++_counter;
+}
+
+template<class V>
+V CuckooHashTable<V>::getValue(int key) {
+    auto value = findValue(key);
+    if (!value) throw HashKeyDoesNotExist();
+    return *value;
+}
+
+template<class V>
+bool CuckooHashTable<V>::includesKey(int key) {
+    return findValue(key) != nullptr;
+}
+
+template<class V>
+void CuckooHashTable<V>::remove(int key) {
+    int first, second;
+    bucketsOf(key, first, second);
+
+    bool removed = false;
+    int bucket = matchMask(&_buckets[first], key) ? first : second;
+    int mask = matchMask(&_buckets[bucket], key);
+    if (mask) {
+        int slot = __builtin_ctz(mask);
+        _buckets[bucket].value(slot)->~V();
+        _buckets[bucket]._occupied &= ~(1 << slot);
+        removed = true;
+    }
+    for (int i = 0; i < _stashCount && !removed; ++i) {
+        if (_stashKeys[i] == key) {
+            delete _stash[i];
+            _stashKeys[i] = _stashKeys[_stashCount - 1];
+            _stash[i] = _stash[_stashCount - 1];
+            _stashCount--;
+            removed = true;
+        }
+    }
+    if (removed) _counter--;
+}
+
+template<class V>
+bool CuckooHashTable<V>::isEmpty() {
+    return _counter <= EMPTY_SIZE;
+}
+
+template<class V>
+int CuckooHashTable<V>::getSize() {
+    return _bucketCount * CUCKOO_WAYS;
+}
+
+template<class V>
+int CuckooHashTable<V>::getCount() {
+    return _counter;
+}
+
+template<class V>
+void CuckooHashTable<V>::destroyHash(ValueDestroyFunction *f) {
+    for (int b = 0; b < _bucketCount; ++b) {
+        for (int s = 0; s < CUCKOO_WAYS; ++s) {
+            if (_buckets[b]._occupied & (1 << s)) f->operator()(*_buckets[b].value(s));
+        }
+    }
+    for (int i = 0; i < _stashCount; ++i) f->operator()(*_stash[i]);
+    int bucketCount = _bucketCount;
+    release();
+    _bucketCount = bucketCount;
+    _buckets = allocate(_bucketCount);
+}
+
+#endif /* CuckooHashTable_H_ */
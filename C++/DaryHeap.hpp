@@ -0,0 +1,260 @@
+#ifndef DARYHEAP_H
+#define DARYHEAP_H
+
+#include<functional>
+#include<iterator>
+#include<new>
+#include<type_traits>
+#include<utility>
+#include "MinHeap.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __SSE4_1__
+#include <smmintrin.h>
+#endif
+
+#define DARY_HEAP_ALIGNMENT 64
+
+/**
+ * D-ary heap, same API as MinHeap. A node has D children, so the tree is log2(D) times
+ * shallower. The array is cache line aligned and shifted by D - 1 slots, so the children
+ * of a node start at a multiple of D: with D * sizeof(T) <= 64 (4 or 8 ints, 8 pointers)
+ * a sibling group never straddles two cache lines.
+ * For int keys ordered by less and D a multiple of 8, a full group's smallest child is
+ * found with SSE2 (SSE4.1 when enabled): a vertical min over the group, a horizontal min,
+ * one compare and movemask. For 4 children the scalar compares have the shorter latency,
+ * and every level waits for the previous one's index.
+ */
+template<class T = int, int D = 4, class Compare = less<T>>
+class DaryHeap {
+    static_assert(D >= 2, "DaryHeap needs at least 2 children per node");
+
+    T* storage;
+    T* heap_array; // storage + D - 1
+    int capacity;
+    int size;
+    Compare compare;
+private:
+
+    static constexpr bool simd_children = is_same<T, int>::value && D % 8 == 0 &&
+                                          (is_same<Compare, less<int>>::value || is_same<Compare, less<>>::value);
+
+    int parent(int i) { return (i - 1) / D; }
+
+    int first_child(int i) { return D * i + 1; }
+
+#ifdef __SSE2__
+    static __m128i min_epi32(__m128i a, __m128i b) {
+#ifdef __SSE4_1__
+        return _mm_min_epi32(a, b);
+#else
+        __m128i lt = _mm_cmplt_epi32(a, b);
+        return _mm_or_si128(_mm_and_si128(lt, a), _mm_andnot_si128(lt, b));
+#endif
+    }
+
+    // Index of the smallest of the D ints at p (16 byte aligned), the first one on ties.
+    static int min_index(const int* p) {
+        __m128i m = _mm_load_si128((const __m128i*) p);
+        for (int k = 4; k < D; k += 4) {
+            m = min_epi32(m, _mm_load_si128((const __m128i*) (p + k)));
+        }
+        m = min_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(1, 0, 3, 2)));
+        m = min_epi32(m, _mm_shuffle_epi32(m, _MM_SHUFFLE(2, 3, 0, 1)));
+        for (int k = 0;; k += 4) {
+            __m128i group = _mm_load_si128((const __m128i*) (p + k));
+            int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(group, m)));
+            if (mask) { return k + __builtin_ctz(mask); }
+        }
+    }
+#endif
+
+    // Smallest of the children of the node whose first child is at first.
+    int min_child(int first) {
+#ifdef __SSE2__
+        if constexpr (simd_children) {
+            if (first + D <= size) { return first + min_index(&heap_array[first]); }
+        }
+#endif
+        int last = first + D < size ? first + D : size;
+        int smallest = first;
+        for (int c = first + 1; c < last; ++c) {
+            if (compare(heap_array[c], heap_array[smallest])) { smallest = c; }
+        }
+        return smallest;
+    }
+
+    // Moves the element at index down to its place.
+    void swift(int index) {
+        T value = std::move(heap_array[index]);
+        int first = first_child(index);
+        while (first < size) {
+            int smallest = min_child(first);
+            if (!compare(heap_array[smallest], value)) { break; }
+            heap_array[index] = std::move(heap_array[smallest]);
+            index = smallest;
+            first = first_child(index);
+        }
+        heap_array[index] = std::move(value);
+    }
+
+    // Moves the element at index up to its place.
+    void sift_up(int index) {
+        T value = std::move(heap_array[index]);
+        while (index != 0 && compare(value, heap_array[parent(index)])) {
+            heap_array[index] = std::move(heap_array[parent(index)]);
+            index = parent(index);
+        }
+        heap_array[index] = std::move(value);
+    }
+
+    static T* allocate(int cap) {
+        return static_cast<T*>(operator new(sizeof(T) * (cap + D - 1), align_val_t(DARY_HEAP_ALIGNMENT)));
+    }
+
+    static void deallocate(T* p) { operator delete(p, align_val_t(DARY_HEAP_ALIGNMENT)); }
+
+    void increase_capacity() { reserve(2 * capacity); }
+
+    void heapify() {
+        for (int i = parent(size - 1); size > 1 && i >= 0; --i) {
+            swift(i);
+        }
+    }
+
+    // Same as MinHeap: the hole goes down to a leaf, then the last element moves in and up.
+    void remove_root() {
+        size--;
+        int index = 0;
+        int first = first_child(index);
+        while (first < size) {
+            int smallest = min_child(first);
+            heap_array[index] = std::move(heap_array[smallest]);
+            index = smallest;
+            first = first_child(index);
+        }
+        if (index != size) {
+            heap_array[index] = std::move(heap_array[size]);
+            sift_up(index);
+        }
+        heap_array[size].~T();
+    }
+
+public:
+
+    int getSize() { return size; }
+
+    bool isEmpty() { return size <= 0; }
+
+    explicit DaryHeap(int cap, const Compare &compare = Compare()) : compare(compare) {
+        if (cap <= 0) { throw HeapIllegalInput(); }
+        size = 0;
+        capacity = cap;
+        storage = allocate(cap);
+        heap_array = storage + D - 1;
+    }
+
+    // Builds the heap from the array in O(n).
+    DaryHeap(int size, const T* array, const Compare &compare = Compare()) : DaryHeap(array, array + size, compare) {}
+
+    // Builds the heap from the range in O(n).
+    template<class It>
+    DaryHeap(It first, It last, const Compare &compare = Compare()) : compare(compare) {
+        auto n = distance(first, last);
+        if (n < 0) { throw HeapIllegalInput(); }
+        size = 0;
+        capacity = n > 0 ? (int) n : 1;
+        storage = allocate(capacity);
+        heap_array = storage + D - 1;
+        for (; first != last; ++first) {
+            new(&heap_array[size]) T(*first);
+            size++;
+        }
+        heapify();
+    }
+
+    DaryHeap(const DaryHeap &) = delete;
+
+    DaryHeap &operator=(const DaryHeap &) = delete;
+
+    ~DaryHeap() {
+        for (int i = 0; i < size; ++i) { heap_array[i].~T(); }
+        deallocate(storage);
+    }
+
+    // Makes room for cap elements, never shrinks.
+    void reserve(int cap) {
+        if (cap <= capacity) { return; }
+        auto bigger = allocate(cap);
+
+        for (int i = 0; i < size; ++i) {
+            new(&bigger[i + D - 1]) T(std::move(heap_array[i]));
+            heap_array[i].~T();
+        }
+        deallocate(storage);
+        capacity = cap;
+        storage = bigger;
+        heap_array = storage + D - 1;
+    }
+
+    // Inserts the range, heapifies the whole array when it's at least as large as the heap.
+    template<class It>
+    void pushRange(It first, It last) {
+        int old_size = size;
+        auto n = distance(first, last);
+        reserve(size + (int) n);
+        for (; first != last; ++first) {
+            new(&heap_array[size]) T(*first);
+            size++;
+        }
+        if (n >= old_size) {
+            heapify();
+        } else {
+            for (int i = old_size; i < size; ++i) {
+                sift_up(i);
+            }
+        }
+    }
+
+    void remove_min() {
+        if (size <= 0)
+            throw HeapIsEmpty();
+        remove_root();
+    }
+
+    const T& get_min() {
+        if (size <= 0)
+            throw HeapIsEmpty();
+        return heap_array[0];
+    }
+
+    void insert(const T& k) { emplace(k); }
+
+    void push(T&& k) { emplace(std::move(k)); }
+
+    template<class... Args>
+    void emplace(Args&&... args) {
+        if (size == capacity) {
+            increase_capacity();
+        }
+
+        new(&heap_array[size]) T(std::forward<Args>(args)...);
+        size++;
+        sift_up(size - 1);
+    }
+
+    // Removes the minimum and returns it, moved out of the array.
+    T pop() {
+        if (size <= 0)
+            throw HeapIsEmpty();
+        T root = std::move(heap_array[0]);
+        remove_root();
+        return root;
+    }
+
+    T extract_min() { return pop(); }
+};
+
+#endif //DARYHEAP_H
@@ -0,0 +1,302 @@
+#ifndef FlatHashTable_H_
+#define FlatHashTable_H_
+
+#include <stdint.h>
+#include <new>
+#include <utility>
+#include "HashTable.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define FLAT_GROUP_SLOTS 15
+#define FLAT_CTRL_EMPTY ((int8_t) -128)
+#define FLAT_OVERFLOW_SATURATED 255
+#define FLAT_MATCH_MASK 0x7FFF
+
+/**
+ * Open addressing hash table (Swiss table style).
+ * Drop-in engine for HashTable: same insert/getValue/remove/includesKey API and exceptions.
+ *
+ * Slots are grouped by 15, every group keeps a 16 bytes control word:
+ * one byte of hash (7 bits) per slot, and one "overflow" byte counting the keys
+ * that probed past this group while it was full.
+ * A lookup loads the control word, compares all 15 bytes at once (SSE2), and
+ * stops at the first group without overflow - usually one control line and one slot line.
+ *
+ * Deletion is tombstone-free: the slot becomes empty again and the overflow
+ * counters on the probe path of the removed key are decremented.
+ */
+template<class V>
+class FlatHashTable {
+private:
+    struct Slot {
+        int _key;
+        V _value;
+
+        Slot(int key, const V &value) : _key(key), _value(value) {}
+
+        Slot(int key, V &&value) : _key(key), _value(std::move(value)) {}
+    };
+
+    struct alignas(16) Group {
+        int8_t _ctrl[FLAT_GROUP_SLOTS];
+        uint8_t _overflow;
+    };
+
+    Group *_groups;
+    Slot *_slots;
+    int _groupCount;
+    int _counter;
+
+    static uint64_t mix(int key);
+
+    static int8_t h2(uint64_t hash) { return (int8_t) (hash & 0x7F); }
+
+    static int matchMask(const Group *group, int8_t tag);
+
+    int homeGroup(uint64_t hash) { return (int) ((hash >> 7) & (uint64_t) (_groupCount - 1)); }
+
+    int findSlot(int key);
+
+    template<class T>
+    void place(int key, T &&value);
+
+    void allocate(int groupCount);
+
+    void release();
+
+    void resize(int groupCount);
+
+    static int groupsFor(int elements);
+
+public:
+
+    class ValueDestroyFunction {
+    public:
+        virtual void operator()(V) {}
+    };
+
+    FlatHashTable() : _groups(nullptr), _slots(nullptr), _groupCount(EMPTY_SIZE), _counter(EMPTY_SIZE) {}
+
+    explicit FlatHashTable(int initial_size);
+
+    FlatHashTable(const FlatHashTable &) = delete;
+
+    FlatHashTable &operator=(const FlatHashTable &) = delete;
+
+    ~FlatHashTable() { release(); }
+
+    V getValue(int key);
+
+    int hashFunction(int key);
+
+    void insert(int key, V value);
+
+    void remove(int key);
+
+    bool includesKey(int key);
+
+    bool isEmpty();
+
+    int getSize();
+
+    void destroyHash(ValueDestroyFunction *f);
+};
+
+template<class V>
+FlatHashTable<V>::FlatHashTable(int initial_size) : FlatHashTable() {
+    if (initial_size > 0) allocate(groupsFor(initial_size));
+}
+
+// Murmur3 finalizer, spreads patterned keys over both the group index and the tag.
+template<class V>
+uint64_t FlatHashTable<V>::mix(int key) {
+    uint64_t h = (uint32_t) key;
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+template<class V>
+int FlatHashTable<V>::matchMask(const Group *group, int8_t tag) {
+#ifdef __SSE2__
+    __m128i ctrl = _mm_load_si128(reinterpret_cast<const __m128i *>(group));
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(tag))) & FLAT_MATCH_MASK;
+#else
+    int mask = 0;
+    for (int i = 0; i < FLAT_GROUP_SLOTS; ++i) {
+        if (group->_ctrl[i] == tag) mask |= 1 << i;
+    }
+    return mask;
+#endif
+}
+
+// Smallest power of two of groups that keeps the load factor under 7/8.
+template<class V>
+int FlatHashTable<V>::groupsFor(int elements) {
+    long long slots = (long long) elements * 8 / 7 + 1;
+    int groups = 1;
+    while ((long long) groups * FLAT_GROUP_SLOTS < slots) groups *= 2;
+    return groups;
+}
+
+template<class V>
+void FlatHashTable<V>::allocate(int groupCount) {
+    _groupCount = groupCount;
+    _groups = new Group[groupCount];
+    for (int g = 0; g < groupCount; ++g) {
+        for (int i = 0; i < FLAT_GROUP_SLOTS; ++i) _groups[g]._ctrl[i] = FLAT_CTRL_EMPTY;
+        _groups[g]._overflow = 0;
+    }
+    _slots = static_cast<Slot *>(::operator new(sizeof(Slot) * groupCount * FLAT_GROUP_SLOTS));
+}
+
+template<class V>
+void FlatHashTable<V>::release() {
+    if (_groupCount == EMPTY_SIZE) return;
+    for (int g = 0; g < _groupCount; ++g) {
+        for (int i = 0; i < FLAT_GROUP_SLOTS; ++i) {
+            if (_groups[g]._ctrl[i] != FLAT_CTRL_EMPTY) _slots[g * FLAT_GROUP_SLOTS + i].~Slot();
+        }
+    }
+    delete[] _groups;
+    ::operator delete(_slots);
+    _groups = nullptr;
+    _slots = nullptr;
+    _groupCount = EMPTY_SIZE;
+    _counter = EMPTY_SIZE;
+}
+
+template<class V>
+int FlatHashTable<V>::findSlot(int key) {
+    if (_groupCount == EMPTY_SIZE) return -1;
+    uint64_t hash = mix(key);
+    int8_t tag = h2(hash);
+    int g = homeGroup(hash);
+
+    for (int step = 1; step <= _groupCount; ++step) {
+        auto group = &_groups[g];
+        for (int mask = matchMask(group, tag); mask; mask &= mask - 1) {
+            int slot = g * FLAT_GROUP_SLOTS + __builtin_ctz(mask);
+            if (_slots[slot]._key == key) return slot;
+        }
+        if (group->_overflow == 0) return -1;
+        g = (g + step) & (_groupCount - 1);
+    }
+    return -1;
+}
+
+// Assumes the key is absent and there is a free slot.
+template<class V>
+template<class T>
+void FlatHashTable<V>::place(int key, T &&value) {
+    uint64_t hash = mix(key);
+    int g = homeGroup(hash);
+
+    for (int step = 1;; ++step) {
+        auto group = &_groups[g];
+        int empty = matchMask(group, FLAT_CTRL_EMPTY);
+        if (empty) {
+            int i = __builtin_ctz(empty);
+            group->_ctrl[i] = h2(hash);
+            new(&_slots[g * FLAT_GROUP_SLOTS + i]) Slot(key, std::forward<T>(value));
+            return;
+        }
+        if (group->_overflow != FLAT_OVERFLOW_SATURATED) group->_overflow++;
+        g = (g + step) & (_groupCount - 1);
+    }
+}
+
+template<class V>
+void FlatHashTable<V>::resize(int groupCount) {
+    auto prevGroups = _groups;
+    auto prevSlots = _slots;
+    int prevCount = _groupCount;
+
+    allocate(groupCount);
+
+    for (int g = 0; g < prevCount; ++g) {
+        for (int i = 0; i < FLAT_GROUP_SLOTS; ++i) {
+            if (prevGroups[g]._ctrl[i] == FLAT_CTRL_EMPTY) continue;
+            auto slot = &prevSlots[g * FLAT_GROUP_SLOTS + i];
+            place(slot->_key, std::move(slot->_value));
+            slot->~Slot();
+        }
+    }
+    delete[] prevGroups;
+    ::operator delete(prevSlots);
+}
+
+template<class V>
+int FlatHashTable<V>::hashFunction(int key) {
+    return _groupCount == EMPTY_SIZE ? EMPTY_SIZE : homeGroup(mix(key));
+}
+
+template<class V>
+void FlatHashTable<V>::insert(int key, V value) {
+    if (findSlot(key) >= 0) throw AvlKeyAlreadyExists();
+
+    if (_groupCount == EMPTY_SIZE) allocate(1);
+    else if ((long long) (_counter + 1) * 8 > (long long) _groupCount * FLAT_GROUP_SLOTS * 7) {
+        resize(_groupCount * 2);
+    }
+    place(key, std::move(value));
+    ++_counter;
+}
+
+template<class V>
+V FlatHashTable<V>::getValue(int key) {
+    int slot = findSlot(key);
+    if (slot < 0) throw HashKeyDoesNotExist();
+    return _slots[slot]._value;
+}
+
+template<class V>
+bool FlatHashTable<V>::includesKey(int key) {
+    return findSlot(key) >= 0;
+}
+
+template<class V>
+void FlatHashTable<V>::remove(int key) {
+    int slot = findSlot(key);
+    if (slot < 0) return;
+
+    int target = slot / FLAT_GROUP_SLOTS;
+    uint64_t hash = mix(key);
+    for (int g = homeGroup(hash), step = 1; g != target; g = (g + step) & (_groupCount - 1), ++step) {
+        if (_groups[g]._overflow != FLAT_OVERFLOW_SATURATED) _groups[g]._overflow--;
+    }
+
+    _slots[slot].~Slot();
+    _groups[target]._ctrl[slot % FLAT_GROUP_SLOTS] = FLAT_CTRL_EMPTY;
+    _counter--;
+
+    if (_groupCount > 1 && _counter * 8 < _groupCount * FLAT_GROUP_SLOTS) resize(_groupCount / 2);
+}
+
+template<class V>
+bool FlatHashTable<V>::isEmpty() {
+    return _counter <= EMPTY_SIZE;
+}
+
+template<class V>
+int FlatHashTable<V>::getSize() {
+    return _groupCount * FLAT_GROUP_SLOTS;
+}
+
+template<class V>
+void FlatHashTable<V>::destroyHash(ValueDestroyFunction *f) {
+    for (int g = 0; g < _groupCount; ++g) {
+        for (int i = 0; i < FLAT_GROUP_SLOTS; ++i) {
+            if (_groups[g]._ctrl[i] != FLAT_CTRL_EMPTY) f->operator()(_slots[g * FLAT_GROUP_SLOTS + i]._value);
+        }
+    }
+    release();
+}
+
+#endif /* FlatHashTable_H_ */
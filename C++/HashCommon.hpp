@@ -0,0 +1,25 @@
+#ifndef HashCommon_H_
+#define HashCommon_H_
+
+#include <exception>
+
+#define EMPTY_SIZE 0
+
+// Keys ahead of the current one whose bucket is prefetched by getMany/insertMany.
+#define HASH_PREFETCH_DISTANCE 8
+
+#if defined(__GNUC__)
+#define HASH_PREFETCH(address) __builtin_prefetch(address)
+#else
+#define HASH_PREFETCH(address)
+#endif
+
+using namespace std;
+
+class HashKeyDoesNotExist : public exception {
+};
+
+class HashIllegalInput : public exception {
+};
+
+#endif /* HashCommon_H_ */
@@ -0,0 +1,48 @@
+#ifndef HashImage_H_
+#define HashImage_H_
+
+#include <stdint.h>
+#include <exception>
+
+#define HASH_IMAGE_MAGIC "HTIMAGE1"
+#define HASH_IMAGE_VERSION 1
+#define HASH_IMAGE_ALIGN 64
+#define HASH_IMAGE_EMPTY_SLOT 0
+
+using namespace std;
+
+class HashImageError : public exception {
+};
+
+/**
+ * On-disk image of a HashTable, written by HashTable::exportImage and read by MappedHashTable.
+ *
+ * [header][slots: capacity * HashImageSlot][values: count * valueSize]
+ * Every section starts on a HASH_IMAGE_ALIGN boundary. The slots are open addressed
+ * with linear probing, a slot refers to its value by index + 1 (0 is an empty slot).
+ */
+struct HashImageHeader {
+    char _magic[8];
+    uint32_t _version;
+    uint32_t _valueSize;
+    uint64_t _capacity;
+    uint64_t _count;
+    uint64_t _slotsOffset;
+    uint64_t _valuesOffset;
+};
+
+struct HashImageSlot {
+    int32_t _key;
+    uint32_t _index;
+};
+
+inline uint64_t hashImageAlign(uint64_t offset) {
+    return (offset + HASH_IMAGE_ALIGN - 1) / HASH_IMAGE_ALIGN * HASH_IMAGE_ALIGN;
+}
+
+// Home slot of a key, capacity is a power of two.
+inline uint64_t hashImageSlot(int key, uint64_t capacity) {
+    return (((uint32_t) key * 0x9E3779B97F4A7C15ULL) >> 17) & (capacity - 1);
+}
+
+#endif /* HashImage_H_ */
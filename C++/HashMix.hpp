@@ -0,0 +1,128 @@
+#ifndef HashMix_H_
+#define HashMix_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <functional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#define HASH_MIX_P0 0x2d358dccaa6c78a5ULL
+#define HASH_MIX_P1 0x8bb84b93962eacc9ULL
+
+using namespace std;
+
+// 64x64 -> 128 bit multiply, a = low half, b = high half.
+inline void hashMum(uint64_t &a, uint64_t &b) {
+#ifdef __SIZEOF_INT128__
+    __uint128_t r = (__uint128_t) a * b;
+    a = (uint64_t) r;
+    b = (uint64_t) (r >> 64);
+#else
+    uint64_t ha = a >> 32, hb = b >> 32, la = (uint32_t) a, lb = (uint32_t) b;
+    uint64_t hh = ha * hb, hl = ha * lb, lh = la * hb, ll = la * lb;
+    uint64_t t = ll + (hl << 32), lo = t + (lh << 32);
+    uint64_t carry = (t < ll) + (lo < t);
+    a = lo;
+    b = hh + (hl >> 32) + (lh >> 32) + carry;
+#endif
+}
+
+// Folded multiply, every output bit depends on every input bit.
+inline uint64_t hashMix(uint64_t a, uint64_t b) {
+    hashMum(a, b);
+    return a ^ b;
+}
+
+inline uint64_t hashRead8(const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, 8);
+    return v;
+}
+
+inline uint64_t hashRead4(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+// wyhash style hash of a byte string: 16 bytes per multiply, short strings without a loop.
+inline uint64_t hashBytes(const void *data, size_t length, uint64_t seed) {
+    auto p = static_cast<const uint8_t *>(data);
+    seed ^= hashMix(seed ^ HASH_MIX_P0, HASH_MIX_P1);
+    uint64_t a, b;
+
+    if (length <= 16) {
+        if (length >= 4) {
+            size_t middle = (length >> 3) << 2;
+            a = (hashRead4(p) << 32) | hashRead4(p + middle);
+            b = (hashRead4(p + length - 4) << 32) | hashRead4(p + length - 4 - middle);
+        } else if (length > 0) {
+            a = ((uint64_t) p[0] << 16) | ((uint64_t) p[length >> 1] << 8) | p[length - 1];
+            b = 0;
+        } else {
+            a = b = 0;
+        }
+    } else {
+        size_t i = length;
+        for (; i > 16; i -= 16, p += 16) seed = hashMix(hashRead8(p) ^ HASH_MIX_P1, hashRead8(p + 8) ^ seed);
+        // The last 16 bytes, overlapping the previous block when the length isn't a multiple of 16.
+        a = hashRead8(p + i - 16);
+        b = hashRead8(p + i - 8);
+    }
+    a ^= HASH_MIX_P1;
+    b ^= seed;
+    hashMum(a, b);
+    return hashMix(a ^ HASH_MIX_P0 ^ length, b ^ HASH_MIX_P1);
+}
+
+// Seed for a HashMix that can't be predicted from outside the process (hash flooding).
+inline uint64_t hashRandomSeed() {
+    random_device device;
+    return ((uint64_t) device() << 32) ^ device();
+}
+
+/**
+ * Default hasher of HashTable, 64 bit hash codes.
+ * Integers and enums: one 64 bit multiply, the high half xored onto the low half (a seeded
+ * hasher uses the 128 bit folded multiply instead). Strings: wyhash style, transparent,
+ * so a string keyed table can be probed by a string_view or a const char * without a copy.
+ * Any other key goes through std::hash and is mixed.
+ * A seeded hasher (see hashRandomSeed) gives every table its own hash function.
+ */
+template<class K, class Enable = void>
+struct HashMix {
+    uint64_t _seed;
+
+    explicit HashMix(uint64_t seed = 0) : _seed(seed) {}
+
+    uint64_t operator()(const K &key) const { return hashMix(hash<K>()(key) ^ _seed, HASH_MIX_P1); }
+};
+
+template<class K>
+struct HashMix<K, typename enable_if<is_integral<K>::value || is_enum<K>::value>::type> {
+    uint64_t _seed;
+
+    explicit HashMix(uint64_t seed = 0) : _seed(seed) {}
+
+    uint64_t operator()(K key) const {
+        if (_seed) return hashMix((uint64_t) key ^ _seed ^ HASH_MIX_P0, HASH_MIX_P1);
+        uint64_t h = (uint64_t) key * HASH_MIX_P0;
+        return h ^ (h >> 32);
+    }
+};
+
+template<class K>
+struct HashMix<K, typename enable_if<is_same<K, string>::value || is_same<K, string_view>::value>::type> {
+    typedef void is_transparent;
+
+    uint64_t _seed;
+
+    explicit HashMix(uint64_t seed = 0) : _seed(seed) {}
+
+    uint64_t operator()(string_view key) const { return hashBytes(key.data(), key.size(), _seed); }
+};
+
+#endif /* HashMix_H_ */
@@ -0,0 +1,249 @@
+#ifndef HashSet_H_
+#define HashSet_H_
+
+#include <stdint.h>
+#include <limits>
+#include <iterator>
+#include <type_traits>
+#include "HashCommon.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define HASH_SET_MAX_LOAD 0.8
+#define HASH_SET_PROBE_LIMIT 64
+#define HASH_SET_MIN_BITS 4
+
+/**
+ * Compact set of 32 or 64 bit integers (HashSet<int>, HashSet<long long>).
+ * The keys themselves are the table: a flat open addressed array with linear probing,
+ * compared 16 bytes at a time (SSE2), about 5 bytes per int at the 0.8 max load factor.
+ *
+ * Probing never wraps around, the array has HASH_SET_PROBE_LIMIT slots after the last home
+ * slot and the table grows when a probe would run past them. Erase shifts the following
+ * keys back (no tombstones). The minimal key marks an empty slot and is kept aside.
+ */
+template<class K>
+class HashSet {
+private:
+    static_assert(is_integral<K>::value && (sizeof(K) == 4 || sizeof(K) == 8), "HashSet holds 32/64 bit integers");
+
+    static const int WIDTH = 16 / sizeof(K);
+    static constexpr K EMPTY = numeric_limits<K>::min();
+
+    K *_keys;
+    int _bits;
+    int _capacity;
+    int _counter;
+    bool _hasEmptyKey;
+
+    int length() { return _capacity + HASH_SET_PROBE_LIMIT + WIDTH; }
+
+    int home(K key) { return (int) (((uint64_t) key * 0x9E3779B97F4A7C15ULL) >> (64 - _bits)); }
+
+    static int matchMask(const K *keys, K key);
+
+    int findSlot(K key);
+
+    bool place(K key);
+
+    void allocate(int bits);
+
+    void rehash(int bits);
+
+public:
+    HashSet() : HashSet(EMPTY_SIZE) {}
+
+    explicit HashSet(int initial_size);
+
+    // Bulk construction, sized once for the whole range.
+    template<class It>
+    HashSet(It first, It last);
+
+    HashSet(const HashSet &) = delete;
+
+    HashSet &operator=(const HashSet &) = delete;
+
+    ~HashSet() { delete[] _keys; }
+
+    // Grows once so n keys fit without rehashing.
+    void reserve(int n);
+
+    // @return false when the key already exists.
+    bool insert(K key);
+
+    bool contains(K key);
+
+    // @return false when the key doesn't exist.
+    bool erase(K key);
+
+    /**
+     * found[i] = contains(keys[i]), with the home slots prefetched `distance` keys ahead.
+     */
+    void containsMany(const K *keys, int n, bool *found, int distance = HASH_PREFETCH_DISTANCE);
+
+    int getCount();
+
+    int getSize();
+
+    bool isEmpty();
+};
+
+template<class K>
+HashSet<K>::HashSet(int initial_size) : _keys(nullptr), _counter(EMPTY_SIZE), _hasEmptyKey(false) {
+    allocate(HASH_SET_MIN_BITS);
+    reserve(initial_size);
+}
+
+template<class K>
+template<class It>
+HashSet<K>::HashSet(It first, It last) : HashSet((int) distance(first, last)) {
+    for (; first != last; ++first) insert(*first);
+}
+
+template<class K>
+void HashSet<K>::allocate(int bits) {
+    _bits = bits;
+    _capacity = 1 << bits;
+    _keys = new K[length()];
+    for (int i = 0; i < length(); ++i) _keys[i] = EMPTY;
+}
+
+template<class K>
+void HashSet<K>::reserve(int n) {
+    int bits = _bits;
+    while ((1 << bits) * HASH_SET_MAX_LOAD < n) bits++;
+    if (bits > _bits) rehash(bits);
+}
+
+// Moves the keys to a 2^bits table, one size up again while some probe would overflow.
+template<class K>
+void HashSet<K>::rehash(int bits) {
+    auto prev = _keys;
+    int prevLength = length();
+
+    for (;; bits++) {
+        allocate(bits);
+        bool fits = true;
+        for (int i = 0; i < prevLength && fits; ++i) {
+            if (prev[i] != EMPTY) fits = place(prev[i]);
+        }
+        if (fits) break;
+        delete[] _keys;
+    }
+    delete[] prev;
+}
+
+template<class K>
+int HashSet<K>::matchMask(const K *keys, K key) {
+#ifdef __SSE2__
+    __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i *>(keys));
+    if (sizeof(K) == 4) {
+        __m128i match = _mm_cmpeq_epi32(group, _mm_set1_epi32((int32_t) key));
+        return _mm_movemask_ps(_mm_castsi128_ps(match));
+    }
+    // 64 bit lanes are equal when both of their 32 bit halves are.
+    __m128i match = _mm_cmpeq_epi32(group, _mm_set1_epi64x((int64_t) key));
+    match = _mm_and_si128(match, _mm_shuffle_epi32(match, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_movemask_pd(_mm_castsi128_pd(match));
+#else
+    int mask = 0;
+    for (int i = 0; i < WIDTH; ++i) {
+        if (keys[i] == key) mask |= 1 << i;
+    }
+    return mask;
+#endif
+}
+
+// Slot of the key, or -1. A probe stops at the first empty slot.
+template<class K>
+int HashSet<K>::findSlot(K key) {
+    for (int i = home(key);; i += WIDTH) {
+        int match = matchMask(_keys + i, key);
+        if (match) return i + __builtin_ctz(match);
+        if (matchMask(_keys + i, EMPTY)) return -1;
+    }
+}
+
+// Assumes the key is absent, false when its probe would pass the end of the array.
+template<class K>
+bool HashSet<K>::place(K key) {
+    for (int i = home(key); i < _capacity + HASH_SET_PROBE_LIMIT; ++i) {
+        if (_keys[i] == EMPTY) {
+            _keys[i] = key;
+            return true;
+        }
+    }
+    return false;
+}
+
+template<class K>
+bool HashSet<K>::insert(K key) {
+    if (key == EMPTY) {
+        if (_hasEmptyKey) return false;
+        _hasEmptyKey = true;
+        _counter++;
+        return true;
+    }
+    if (findSlot(key) >= 0) return false;
+
+    if (_counter + 1 > _capacity * HASH_SET_MAX_LOAD) rehash(_bits + 1);
+    while (!place(key)) rehash(_bits + 1);
+    _counter++;
+    return true;
+}
+
+template<class K>
+bool HashSet<K>::contains(K key) {
+    if (key == EMPTY) return _hasEmptyKey;
+    return findSlot(key) >= 0;
+}
+
+template<class K>
+bool HashSet<K>::erase(K key) {
+    if (key == EMPTY) {
+        if (!_hasEmptyKey) return false;
+        _hasEmptyKey = false;
+        _counter--;
+        return true;
+    }
+    int hole = findSlot(key);
+    if (hole < 0) return false;
+
+    // Backward shift: pull back every following key whose probe passes the hole.
+    for (int i = hole + 1; _keys[i] != EMPTY; ++i) {
+        if (home(_keys[i]) <= hole) {
+            _keys[hole] = _keys[i];
+            hole = i;
+        }
+    }
+    _keys[hole] = EMPTY;
+    _counter--;
+    return true;
+}
+
+template<class K>
+void HashSet<K>::containsMany(const K *keys, int n, bool *found, int distance) {
+    for (int i = 0; i < n; ++i) {
+        if (i + distance < n) HASH_PREFETCH(_keys + home(keys[i + distance]));
+        found[i] = contains(keys[i]);
+    }
+}
+
+template<class K>
+int HashSet<K>::getCount() {
+    return _counter;
+}
+
+template<class K>
+int HashSet<K>::getSize() {
+    return _capacity;
+}
+
+template<class K>
+bool HashSet<K>::isEmpty() {
+    return _counter <= EMPTY_SIZE;
+}
+
+#endif /* HashSet_H_ */
@@ -1,27 +1,233 @@
+#ifndef HashTable_H_
+#define HashTable_H_
+
+#include <stdint.h>
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <stdio.h>
+#include <string.h>
+#include <type_traits>
+#include "BlockedBloomFilter.hpp"
+#include "HashCommon.hpp"
+#include "HashImage.hpp"
+#include "HashMix.hpp"
+
+#ifdef HASH_TABLE_STATS
+#define AVL_RANK_TREE_STATS
+#include <atomic>
+#include <chrono>
+#include <ostream>
+#define HASH_STAT(...) __VA_ARGS__
+#else
+#define HASH_STAT(...)
+#endif
+
 #include "AvlRankTree.hpp"
 
-#define EMPTY_SIZE 0
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define DEFAULT_MAX_LOAD 1.0
+#define DEFAULT_MIN_LOAD 0.25
+#define MIN_SHRINK_SIZE 40
+
+// Old buckets moved to the new table on every insert/remove while a resize is in progress.
+#define HASH_MIGRATION_STEP 8
+
+// Entries a HashTable keeps inline, without buckets, until it outgrows them.
+#define HASH_INLINE_ENTRIES 8
+
+// Largest sizeof(K) + sizeof(V) kept inline by default, larger entries would bloat every table object.
+#define HASH_INLINE_MAX_ENTRY 16
+
+// Default false positive rate of the prefilter, see HashTable::enablePrefilter.
+#define HASH_PREFILTER_RATE 0.01
 
-class HashKeyDoesNotExist : public exception {
+
+#ifdef HASH_TABLE_STATS
+#define HASH_STATS_HISTOGRAM 8
+
+/**
+ * Snapshot of a HashTable's internals, compiled only with HASH_TABLE_STATS defined.
+ * occupancy[i] is the number of buckets holding i entries, the last one counts the
+ * buckets holding HASH_STATS_HISTOGRAM or more.
+ */
+struct HashTableStats {
+    int buckets;
+    int entries;
+    int trees;
+    long occupancy[HASH_STATS_HISTOGRAM + 1];
+    int longestChain;
+    int deepestTree;
+    long resizes;
+    double resizeSeconds;
+    long rotations;
+    long bucketArrayBytes;
+    long treeBytes;
+    long nodeBytes;
+    long filterBytes;
+    long hits;
+    long misses;
+
+    void dump(ostream &os) const {
+        os << "{\"buckets\":" << buckets << ",\"entries\":" << entries << ",\"trees\":" << trees
+           << ",\"occupancy\":[";
+        for (int i = 0; i <= HASH_STATS_HISTOGRAM; ++i) os << (i ? "," : "") << occupancy[i];
+        os << "],\"longestChain\":" << longestChain << ",\"deepestTree\":" << deepestTree
+           << ",\"resizes\":" << resizes << ",\"resizeSeconds\":" << resizeSeconds
+           << ",\"rotations\":" << rotations
+           << ",\"bytes\":{\"bucketArray\":" << bucketArrayBytes << ",\"trees\":" << treeBytes
+           << ",\"nodes\":" << nodeBytes << ",\"filter\":" << filterBytes << "}"
+           << ",\"hits\":" << hits << ",\"misses\":" << misses << "}";
+    }
 };
+#endif
 
-template<class V>
+template<class V, class K, class Hash, class Eq>
+class PerfectHashTable;
+
+/**
+ * Chained hash table, every bucket is an AVL tree.
+ * Keys are hashed to 64 bit codes by Hash (HashMix by default) and compared by Eq.
+ * The bucket trees are keyed by the hash code, so every entry caches its code: a tree
+ * descent compares integers only and a resize never hashes a key again.
+ * With a transparent Hash and Eq (the defaults), the lookups accept any key type
+ * the two accept, e.g. a string_view for a string keyed table.
+ *
+ * Up to Inline entries are kept in arrays inside the table object and found by a scan
+ * (SSE2 for int keys), with no allocation and no hashing. The first insert past them
+ * moves them to buckets, the table stays hashed until it is cleared. Inline = 0 disables it,
+ * the default is HASH_INLINE_ENTRIES for entries up to HASH_INLINE_MAX_ENTRY bytes and 0 otherwise.
+ */
+template<class V, class K = int, class Hash = HashMix<K>, class Eq = equal_to<>,
+        int Inline = (sizeof(K) + sizeof(V) <= HASH_INLINE_MAX_ENTRY ? HASH_INLINE_ENTRIES : 0)>
 class HashTable {
 private:
+    // Rounded up to whole 16 byte groups of int keys for the SSE2 scan.
+    static const int INLINE_SLOTS = Inline > 0 ? (Inline + 3) / 4 * 4 : 1;
+
     struct Node {
-        int _key;
+        K _key;
         V _value;
+        // Next entry with the same hash code, in practice only under a 64 bit collision.
+        Node *_next;
 
-        Node(int key, V value) : _key(key), _value(value) {}
+        template<class... Args>
+        Node(const K &key, Args &&... args) : _key(key), _value(std::forward<Args>(args)...), _next(nullptr) {}
+
+        ~Node() { delete _next; }
     };
 
-    AVLRankTree<int, Node> **_hashTable;
+    typedef AVLRankTree<uint64_t, Node> Tree;
+
+    Tree **_hashTable;
     int _size;
     int _counter;
+    Hash _hash;
+    Eq _eq;
+
+    // Inline entries, constructed in place, valid while there are no buckets.
+    alignas(K) unsigned char _inlineKeys[INLINE_SLOTS * sizeof(K)];
+    alignas(V) unsigned char _inlineValues[INLINE_SLOTS * sizeof(V)];
+    int _inlineCount;
+
+    // Incremental resize: the previous table stays live until all of its buckets are migrated.
+    Tree **_oldTable;
+    int _oldSize;
+    int _migrated;
+
+    double _maxLoad;
+    double _minLoad;
+    int _reserved;
+
+    // Optional prefilter of the hash codes, sized for the entries that fit before the next resize.
+    unique_ptr<BlockedBloomFilter> _filter;
+    double _filterRate; // 0 when disabled
+
+#ifdef HASH_TABLE_STATS
+    struct Counters {
+        long _resizes = 0;
+        long _resizeNanos = 0;
+        long _rotations = 0;
+        atomic<long> _hits{0};
+        atomic<long> _misses{0};
+    } _stats;
+
+    static long nanosSince(chrono::steady_clock::time_point start) {
+        return (long) chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+    }
+#endif
+
+    template<class Q>
+    uint64_t hashOf(const Q &key) const { return (uint64_t) _hash(key); }
+
+    // Scales the high 32 bits of the code to [0, size): a multiply instead of a 64 bit division.
+    static int bucketOf(uint64_t hash, int size) { return (int) (((hash >> 32) * (uint64_t) size) >> 32); }
+
+    bool hasBuckets() { return _size > EMPTY_SIZE; }
+
+    K *inlineKeys() { return reinterpret_cast<K *>(_inlineKeys); }
+
+    V *inlineValues() { return reinterpret_cast<V *>(_inlineValues); }
+
+    // Index of the inline entry of the key, or -1.
+    template<class Q>
+    int findInline(const Q &key);
+
+    template<class... Args>
+    void emplaceInline(const K &key, Args &&... args);
+
+    void removeInline(int index);
 
-    void init(AVLRankTree<int, Node> **array, int key, V value);
+    // Moves the inline entries into the (just allocated) buckets.
+    void spillInline();
 
-    void resize(bool toShrink);
+    // Links a new node into the current table, chained when its hash code is already there.
+    void place(uint64_t hash, Node *node);
+
+    template<class Q>
+    V *findValue(const Q &key);
+
+    void attach(Tree **array, int size, uint64_t hash, Node *node);
+
+    Tree *findTree(uint64_t hash);
+
+    // First entry of the hash code, nullptr when there is none.
+    Node *findHead(uint64_t hash);
+
+    template<class Q>
+    Node *findNode(const Q &key, uint64_t hash);
+
+    // findNode for the public lookups, counted as hit/miss in the stats.
+    template<class Q>
+    Node *lookup(const Q &key, uint64_t hash);
+
+    template<class... Args>
+    void emplaceHashed(uint64_t hash, const K &key, Args &&... args);
+
+    void resize(int newSize);
+
+    int bucketsFor(int entries);
+
+    void grow(int entries);
+
+    uint64_t *hashesOf(const K *keys, int n);
+
+    void prefetch(const uint64_t *hashes, int n, int i, int distance);
+
+    void migrateBucket();
+
+    void migrate(int buckets);
+
+    bool isMigrating() { return _oldTable != nullptr; }
+
+    bool filtered(uint64_t hash) { return _filter && !_filter->mayContain(hash); }
+
+    void rebuildFilter();
 
 public:
 
@@ -30,152 +236,898 @@ public:
         virtual void operator()(V) {}
     };
 
-    HashTable() : _size(EMPTY_SIZE), _counter(EMPTY_SIZE) {}
+    explicit HashTable(const Hash &hash = Hash(), const Eq &eq = Eq())
+            : _hashTable(nullptr), _size(EMPTY_SIZE), _counter(EMPTY_SIZE), _hash(hash), _eq(eq),
+              _inlineCount(0), _oldTable(nullptr), _oldSize(EMPTY_SIZE), _migrated(0),
+              _maxLoad(DEFAULT_MAX_LOAD), _minLoad(DEFAULT_MIN_LOAD), _reserved(EMPTY_SIZE), _filterRate(0) {}
+
+    // Allocates initial_size * 2 buckets right away, the table starts hashed rather than inline.
+    explicit HashTable(int initial_size, const Hash &hash = Hash(), const Eq &eq = Eq());
+
+    /**
+     * Bulk construction in O(n): sizes the table once, groups the entries by bucket
+     * and builds every bucket tree from its sorted entries.
+     * @param first, last - range of pairs (key, value) with distinct keys.
+     */
+    template<class It>
+    HashTable(It first, It last, const Hash &hash = Hash(), const Eq &eq = Eq());
+
+    ~HashTable() { clear(); }
+
+    /**
+     * Resizes once so n entries fit without any further growth,
+     * the table won't shrink below it either.
+     */
+    void reserve(int n);
+
+    /**
+     * Grow when entries > buckets * maxLoad, shrink (half) when entries <= buckets * minLoad.
+     * minLoad * 2 has to stay under maxLoad, so a shrink can't trigger a grow right back.
+     */
+    void setLoadFactors(double maxLoad, double minLoad);
+
+    /**
+     * Puts a blocked Bloom filter of the hash codes in front of the buckets, a lookup of a missing
+     * key is then usually rejected by reading one cache line. Bloom filters can't delete, removed
+     * keys stay in it until the next resize rebuilds it (from the cached codes).
+     * @param falsePositiveRate - in (0, 1), lower costs more bits per entry.
+     */
+    void enablePrefilter(double falsePositiveRate = HASH_PREFILTER_RATE);
+
+    void disablePrefilter();
 
-    explicit HashTable(int initial_size);
+    template<class Q>
+    V getValue(const Q &key);
 
-    V getValue(int key);
+    void insert(const K &key, const V &value);
 
-    int hashFunction(int key);
+    void insert(const K &key, V &&value);
 
-    void insert(int key, V value);
+    // Constructs the value in place from args, throws AvlKeyAlreadyExists when the key exists.
+    template<class... Args>
+    void emplace(const K &key, Args &&... args);
 
-    void remove(int key);
+    /**
+     * Pointer to the value of the key, or nullptr when it doesn't exist. Never throws or copies.
+     * Hashed entries never move, the pointer stays valid until the key is removed.
+     * Inline entries move on insert/remove, their pointers are valid until the next one.
+     */
+    template<class Q>
+    V *find(const Q &key);
 
-    bool includesKey(int key);
+    /**
+     * Batched lookup: hashes all the keys first, then resolves them while prefetching
+     * the buckets of the keys `distance` positions ahead (bucket slot, tree, tree root).
+     * @param out - out[i] is the value of keys[i] when found[i] is true.
+     */
+    void getMany(const K *keys, int n, V *out, bool *found, int distance = HASH_PREFETCH_DISTANCE);
+
+    /**
+     * Batched insert: grows once for the whole batch, then inserts with the same prefetching as getMany.
+     * Throws AvlKeyAlreadyExists on the first existing key, the keys before it stay inserted.
+     */
+    void insertMany(const K *keys, const V *values, int n, int distance = HASH_PREFETCH_DISTANCE);
+
+    template<class Q>
+    void remove(const Q &key);
+
+    template<class Q>
+    bool includesKey(const Q &key);
 
     bool isEmpty();
 
     int getSize();
 
+    // Number of stored entries (getSize() is the number of buckets).
+    int getCount();
+
+    /**
+     * Forward iterator over all the entries, *it is a pair (key, value reference).
+     * Walks the buckets and the tree nodes directly, without allocating.
+     * Invalidated by insert/remove.
+     */
+    class Iterator {
+    private:
+        typedef typename Tree::Iterator TreeIterator;
+
+        HashTable *_table;
+        int _phase;
+        int _bucket;
+        TreeIterator _node;
+        Node *_entry;
+
+        Iterator(HashTable *table, int phase, int bucket) : _table(table), _phase(phase), _bucket(bucket),
+                                                            _entry(nullptr) {}
+
+        void settle();
+
+        friend class HashTable;
+
+    public:
+        pair<const K &, V &> operator*() const {
+            if (!_entry) return pair<const K &, V &>(_table->inlineKeys()[_bucket], _table->inlineValues()[_bucket]);
+            return pair<const K &, V &>(_entry->_key, _entry->_value);
+        }
+
+        Iterator &operator++();
+
+        bool operator==(const Iterator &it) const {
+            return _phase == it._phase && _bucket == it._bucket && _node == it._node && _entry == it._entry;
+        }
+
+        bool operator!=(const Iterator &it) const { return !(*this == it); }
+    };
+
+    Iterator begin();
+
+    Iterator end();
+
+    // Calls f(key, value) for every entry, without allocating.
+    template<class F>
+    void forEach(F f);
+
+    // Removes (destructs) all the entries.
+    void clear();
+
     void destroyHash(ValueDestroyFunction *f);
+
+    /**
+     * Writes an immutable open addressed image of the table, to be served by MappedHashTable.
+     * Int keys only, V has to be trivially copyable. Throws HashImageError when the file can't be written.
+     */
+    void exportImage(const char *path);
+
+    /**
+     * Immutable copy of the current entries behind a minimal perfect hash, one probe per lookup.
+     * Reuses the cached hash codes, the build runs on `threads` threads (0: one per hardware thread).
+     * Defined in PerfectHashTable.hpp, include it to call. The caller owns the result.
+     * Throws PerfectHashBuildError when two keys have the same 64 bit hash code.
+     */
+    PerfectHashTable<V, K, Hash, Eq> *buildPerfect(int threads = 0);
+
+#ifdef HASH_TABLE_STATS
+    // Scans all the buckets, O(buckets + entries). Not synchronized with concurrent writers.
+    HashTableStats getStats();
+#endif
 };
 
-template<class V>
-HashTable<V>::HashTable(int initial_size) {
+template<class V, class K, class Hash, class Eq, int Inline>
+HashTable<V, K, Hash, Eq, Inline>::HashTable(int initial_size, const Hash &hash, const Eq &eq) : HashTable(hash, eq) {
+    if (initial_size <= 0) return;
     _size = initial_size * 2;
-    _counter = EMPTY_SIZE;
-    _hashTable = new AVLRankTree<int, Node> *[_size];
+    _hashTable = new Tree *[_size];
 
     for (int i = 0; i < _size; ++i) {
         _hashTable[i] = NULL;
     }
 }
 
-template<class V>
-int HashTable<V>::hashFunction(int key) {
-    return key % _size;
+template<class V, class K, class Hash, class Eq, int Inline>
+template<class It>
+HashTable<V, K, Hash, Eq, Inline>::HashTable(It first, It last, const Hash &hash, const Eq &eq) : HashTable(hash, eq) {
+    int n = (int) distance(first, last);
+    if (n == 0) return;
+    if (n <= Inline) {
+        try {
+            for (; first != last; ++first) emplace(first->first, first->second);
+        } catch (...) {
+            clear();
+            throw;
+        }
+        return;
+    }
+
+    _size = bucketsFor(n);
+    _hashTable = new Tree *[_size];
+    for (int i = 0; i < _size; i++) { _hashTable[i] = nullptr; }
+
+    // Counting sort of the new nodes by bucket.
+    auto hashes = new uint64_t[n];
+    auto offsets = new int[_size + 1]();
+    int count = 0;
+    for (It it = first; it != last; ++it, ++count) {
+        hashes[count] = hashOf(it->first);
+        offsets[bucketOf(hashes[count], _size) + 1]++;
+    }
+    for (int i = 0; i < _size; ++i) offsets[i + 1] += offsets[i];
+
+    auto nodes = new pair<uint64_t, Node *>[n];
+    auto fill = new int[_size];
+    for (int i = 0; i < _size; ++i) fill[i] = offsets[i];
+    count = 0;
+    for (It it = first; it != last; ++it, ++count) {
+        nodes[fill[bucketOf(hashes[count], _size)]++] = make_pair(hashes[count], new Node(it->first, it->second));
+    }
+    delete[] fill;
+
+    // Every bucket sorted by hash code, the entries of a code are checked against each other.
+    bool duplicate = false;
+    for (int b = 0; b < _size && !duplicate; ++b) {
+        int begin = offsets[b], end = offsets[b + 1];
+        sort(nodes + begin, nodes + end, [](const pair<uint64_t, Node *> &x, const pair<uint64_t, Node *> &y) {
+            return x.first < y.first;
+        });
+        for (int i = begin; i < end && !duplicate; ++i) {
+            for (int j = i - 1; j >= begin && nodes[j].first == nodes[i].first; --j) {
+                if (_eq(nodes[j].second->_key, nodes[i].second->_key)) duplicate = true;
+            }
+        }
+    }
+
+    if (duplicate) {
+        for (int i = 0; i < n; ++i) delete nodes[i].second;
+        delete[] _hashTable;
+        _hashTable = nullptr;
+        _size = EMPTY_SIZE;
+    } else {
+        auto codes = new uint64_t[n];
+        auto heads = new Node *[n];
+        for (int b = 0; b < _size; ++b) {
+            int headCount = 0;
+            for (int i = offsets[b]; i < offsets[b + 1]; ++i) {
+                if (headCount > 0 && codes[headCount - 1] == nodes[i].first) {
+                    nodes[i].second->_next = heads[headCount - 1]->_next;
+                    heads[headCount - 1]->_next = nodes[i].second;
+                } else {
+                    codes[headCount] = nodes[i].first;
+                    heads[headCount++] = nodes[i].second;
+                }
+            }
+            if (headCount == 0) continue;
+            _hashTable[b] = new Tree();
+            _hashTable[b]->setTreeFromSortedNodes(codes, heads, headCount);
+        }
+        delete[] codes;
+        delete[] heads;
+        _counter = n;
+    }
+    delete[] hashes;
+    delete[] nodes;
+    delete[] offsets;
+    if (duplicate) throw AvlKeyAlreadyExists();
+}
+
+template<class V, class K, class Hash, class Eq, int Inline>
+int HashTable<V, K, Hash, Eq, Inline>::bucketsFor(int entries) {
+    int buckets = (int) (entries / _maxLoad);
+    while (buckets * _maxLoad < entries) buckets++;
+    return buckets > 0 ? buckets : 1;
+}
+
+template<class V, class K, class Hash, class Eq, int Inline>
+void HashTable<V, K, Hash, Eq, Inline>::reserve(int n) {
+    if (n < 0) throw HashIllegalInput();
+    _reserved = n;
+    grow(n);
+}
+
+template<class V, class K, class Hash, class Eq, int Inline>
+void HashTable<V, K, Hash, Eq, Inline>::grow(int entries) {
+    if (!hasBuckets() && entries <= Inline) return;
+    int buckets = bucketsFor(entries);
+    if (buckets <= _size) return;
+
+    if (_size == EMPTY_SIZE) {
+        _size = buckets;
+        _hashTable = new Tree *[_size];
+        for (int i = 0; i < _size; i++) { _hashTable[i] = nullptr; }
+        rebuildFilter();
+        spillInline();
+    } else {
+        resize(buckets);
+    }
+}
+
+template<class V, class K, class Hash, class Eq, int Inline>
+void HashTable<V, K, Hash, Eq, Inline>::setLoadFactors(double maxLoad, double minLoad) {
+    if (maxLoad <= 0 || minLoad < 0 || minLoad * 2 >= maxLoad) throw HashIllegalInput();
+    _maxLoad = maxLoad;
+    _minLoad = minLoad;
+    rebuildFilter();
 }
 
-template<class V>
-void HashTable<V>::insert(int key, const V value) {
+template<class V, class K, class Hash, class Eq, int Inline>
+void HashTable<V, K, Hash, Eq, Inline>::enablePrefilter(double falsePositiveRate) {
+    if (!(falsePositiveRate > 0 && falsePositiveRate < 1)) throw HashIllegalInput();
+    _filterRate = falsePositiveRate;
+    rebuildFilter();
+}
+
+template<class V, class K, class Hash, class Eq, int Inline>
+void HashTable<V, K, Hash, Eq, Inline>::disablePrefilter() {
+    _filterRate = 0;
+    _filter.reset();
+}
+
+// Refills the filter from the hash codes of both tables, sized for the current capacity.
+template<class V, class K, class Hash, class Eq, int Inline>
+void HashTable<V, K, Hash, Eq, Inline>::rebuildFilter() {
+    // Inline entries aren't filtered.
+    if (_filterRate == 0 || !hasBuckets()) {
+        _filter.reset();
+        return;
+    }
+    int capacity = (int) (_size * _maxLoad);
+    _filter.reset(new BlockedBloomFilter(capacity > _counter ? capacity : _counter, _filterRate));
+
+    for (int t = 0; t < 2; ++t) {
+        auto array = t == 0 ? _hashTable : _oldTable;
+        int size = t == 0 ? _size : _oldSize;
+        for (int i = t == 0 ? 0 : _migrated; i < size; ++i) {
+            if (!array[i]) continue;
+            for (auto it = array[i]->begin(); it != array[i]->end(); ++it) _filter->add(it.key());
+        }
+    }
+}
+
+template<class V, class K, class Hash, class Eq, int Inline>
+void HashTable<V, K, Hash, Eq, Inline>::insert(const K &key, const V &value) {
+    emplace(key, value);
+}
+
+template<class V, class K, class Hash, class Eq, int Inline>
+void HashTable<V, K, Hash, Eq, Inline>::insert(const K &key, V &&value) {
+    emplace(key, std::move(value));
+}
+
+template<class V, class K, class Hash, class Eq, int Inline>
+template<class... Args>
+void HashTable<V, K, Hash, Eq, Inline>::emplace(const K &key, Args &&... args) {
+    if (Inline > 0 && !hasBuckets()) {
+        emplaceInline(key, std::forward<Args>(args)...);
+    } else {
+        emplaceHashed(hashOf(key), key, std::forward<Args>(args)...);
+    }
+}
+
+template<class V, class K, class Hash, class Eq, int Inline>
+template<class... Args>
+void HashTable<V, K, Hash, Eq, Inline>::emplaceInline(const K &key, Args &&... args) {
+    if (findInline(key) >= 0) throw AvlKeyAlreadyExists();
+
+    if (_inlineCount == Inline) {
+        grow(_counter + 1);
+        emplaceHashed(hashOf(key), key, std::forward<Args>(args)...);
+        return;
+    }
+    new(&inlineValues()[_inlineCount]) V(std::forward<Args>(args)...);
+    new(&inlineKeys()[_inlineCount]) K(key);
+    _inlineCount++;
+    _counter++;
+}
+
+template<class V, class K, class Hash, class Eq, int Inline>
+template<class Q>
+int HashTable<V, K, Hash, Eq, Inline>::findInline(const Q &key) {
+#ifdef __SSE2__
+    if constexpr (is_same<K, int>::value && is_same<Q, int>::value) {
+        __m128i needle = _mm_set1_epi32(key);
+        for (int i = 0; i < _inlineCount; i += 4) {
+            __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i *>(inlineKeys() + i));
+            int match = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(group, needle)));
+            // Lanes past the last entry hold garbage.
+            if (_inlineCount - i < 4) match &= (1 << (_inlineCount - i)) - 1;
+            if (match) return i + __builtin_ctz(match);
+        }
+        return -1;
+    }
+#endif
+    for (int i = 0; i < _inlineCount; ++i) {
+        if (_eq(inlineKeys()[i], key)) return i;
+    }
+    return -1;
+}
+
+// The last entry fills the hole.
+template<class V, class K, class Hash, class Eq, int Inline>
+void HashTable<V, K, Hash, Eq, Inline>::removeInline(int index) {
+    int last = _inlineCount - 1;
+    if (index != last) {
+        inlineKeys()[index] = std::move(inlineKeys()[last]);
+        inlineValues()[index] = std::move(inlineValues()[last]);
+    }
+    inlineKeys()[last].~K();
+    inlineValues()[last].~V();
+    _inlineCount--;
+    _counter--;
+}
+
+template<class V, class K, class Hash, class Eq, int Inline>
+void HashTable<V, K, Hash, Eq, Inline>::spillInline() {
+    for (int i = 0; i < _inlineCount; ++i) {
+        place(hashOf(inlineKeys()[i]), new Node(inlineKeys()[i], std::move(inlineValues()[i])));
+        inlineKeys()[i].~K();
+        inlineValues()[i].~V();
+    }
+    _inlineCount = 0;
+}
+
+template<class V, class K, class Hash, class Eq, int Inline>
+void HashTable<V, K, Hash, Eq, Inline>::place(uint64_t hash, Node *node) {
+    auto head = findHead(hash);
+    if (head) {
+        node->_next = head->_next;
+        head->_next = node;
+    } else {
+        attach(_hashTable, _size, hash, node);
+    }
+    if (_filter) _filter->add(hash);
+}
+
+template<class V, class K, class Hash, class Eq, int Inline>
+template<class... Args>
+void HashTable<V, K, Hash, Eq, Inline>::emplaceHashed(uint64_t hash, const K &key, Args &&... args) {
+    auto head = findHead(hash);
+    for (auto node = head; node; node = node->_next) {
+        if (_eq(node->_key, key)) throw AvlKeyAlreadyExists();
+    }
+
     if (_size == 0) {
         _size = 1;
-        auto initHash = new AVLRankTree<int, Node> *[_size];
+        auto initHash = new Tree *[_size];
         for (int i = 0; i < _size; i++) initHash[i] = nullptr;
 
-
-        init(initHash, key, value);
         _hashTable = initHash;
+        rebuildFilter();
     } else {
-        if (_counter == _size) resize(false);
-        init(_hashTable, key, value);
+        migrate(HASH_MIGRATION_STEP);
+        if (_counter + 1 > _size * _maxLoad) resize(_size * 2);
     }
+
+    // Nodes never move, the head found above is still valid after the migration.
+    auto node = new Node(key, std::forward<Args>(args)...);
+    if (head) {
+        node->_next = head->_next;
+        head->_next = node;
+    } else {
+        attach(_hashTable, _size, hash, node);
+    }
+    if (_filter) _filter->add(hash);
     ++_counter;
 }
 
-template<class V>
-V HashTable<V>::getValue(int key) {
-    auto tree = _hashTable[hashFunction(key)];
-    if (!tree) { throw HashKeyDoesNotExist(); }
-    return tree->getValue(key)->_value;
+// Hash codes of buckets not yet migrated may still live in the old table.
+template<class V, class K, class Hash, class Eq, int Inline>
+typename HashTable<V, K, Hash, Eq, Inline>::Tree *HashTable<V, K, Hash, Eq, Inline>::findTree(uint64_t hash) {
+    if (!hasBuckets() || filtered(hash)) return nullptr;
+    auto tree = _hashTable[bucketOf(hash, _size)];
+    if (tree && tree->includes(hash)) return tree;
+
+    if (isMigrating() && bucketOf(hash, _oldSize) >= _migrated) {
+        tree = _oldTable[bucketOf(hash, _oldSize)];
+        if (tree && tree->includes(hash)) return tree;
+    }
+    return nullptr;
 }
 
-template<class V>
-void HashTable<V>::resize(bool toShrink) {
-    int prev_size = _size;
+template<class V, class K, class Hash, class Eq, int Inline>
+typename HashTable<V, K, Hash, Eq, Inline>::Node *HashTable<V, K, Hash, Eq, Inline>::findHead(uint64_t hash) {
+    if (!hasBuckets()) return nullptr;
+    // The bucket slot is loaded while the filter is probed, a hit doesn't wait for both in turn.
+    auto slot = &_hashTable[bucketOf(hash, _size)];
+    if (_filter) {
+        HASH_PREFETCH(slot);
+        if (!_filter->mayContain(hash)) return nullptr;
+    }
+    auto tree = *slot;
+    Node *node = tree ? tree->find(hash) : nullptr;
+
+    if (!node && isMigrating() && bucketOf(hash, _oldSize) >= _migrated) {
+        tree = _oldTable[bucketOf(hash, _oldSize)];
+        node = tree ? tree->find(hash) : nullptr;
+    }
+    return node;
+}
+
+template<class V, class K, class Hash, class Eq, int Inline>
+template<class Q>
+typename HashTable<V, K, Hash, Eq, Inline>::Node *HashTable<V, K, Hash, Eq, Inline>::findNode(const Q &key, uint64_t hash) {
+    auto node = findHead(hash);
+    while (node && !_eq(node->_key, key)) node = node->_next;
+    return node;
+}
+
+template<class V, class K, class Hash, class Eq, int Inline>
+template<class Q>
+typename HashTable<V, K, Hash, Eq, Inline>::Node *HashTable<V, K, Hash, Eq, Inline>::lookup(const Q &key, uint64_t hash) {
+    auto node = findNode(key, hash);
+    HASH_STAT((node ? _stats._hits : _stats._misses).fetch_add(1, memory_order_relaxed));
+    return node;
+}
+
+template<class V, class K, class Hash, class Eq, int Inline>
+template<class Q>
+V *HashTable<V, K, Hash, Eq, Inline>::findValue(const Q &key) {
+    if (Inline > 0 && !hasBuckets()) {
+        int i = findInline(key);
+        HASH_STAT((i >= 0 ? _stats._hits : _stats._misses).fetch_add(1, memory_order_relaxed));
+        return i >= 0 ? &inlineValues()[i] : nullptr;
+    }
+    auto node = lookup(key, hashOf(key));
+    return node ? &node->_value : nullptr;
+}
+
+template<class V, class K, class Hash, class Eq, int Inline>
+template<class Q>
+V HashTable<V, K, Hash, Eq, Inline>::getValue(const Q &key) {
+    auto value = findValue(key);
+    if (!value) { throw HashKeyDoesNotExist(); }
+    return *value;
+}
+
+template<class V, class K, class Hash, class Eq, int Inline>
+template<class Q>
+V *HashTable<V, K, Hash, Eq, Inline>::find(const Q &key) {
+    return findValue(key);
+}
 
-    if (toShrink) _size /= 2;
-    else _size *= 2;
+// Starts a resize, the entries are moved by the following operations, see migrate().
+template<class V, class K, class Hash, class Eq, int Inline>
+void HashTable<V, K, Hash, Eq, Inline>::resize(int newSize) {
+    if (isMigrating()) migrate(_oldSize);
+    HASH_STAT(auto start = chrono::steady_clock::now());
 
-    auto new_hash = new AVLRankTree<int, Node> *[_size];
-    for (int i = 0; i < _size; i++) { new_hash[i] = nullptr; }
+    _oldTable = _hashTable;
+    _oldSize = _size;
+    _migrated = 0;
+    _size = newSize;
 
-    for (int i = 0; i < prev_size; i++) {
+    _hashTable = new Tree *[_size];
+    for (int i = 0; i < _size; i++) { _hashTable[i] = nullptr; }
+    rebuildFilter();
 
-        auto tree = _hashTable[i];
-        if (tree == nullptr) continue;
+    HASH_STAT(_stats._resizes++);
+    HASH_STAT(_stats._resizeNanos += nanosSince(start));
+}
+
+// Moves the nodes of the next old bucket into the new table by their cached hash codes, no key is hashed.
+template<class V, class K, class Hash, class Eq, int Inline>
+void HashTable<V, K, Hash, Eq, Inline>::migrateBucket() {
+    auto tree = _oldTable[_migrated];
+    if (tree != nullptr) {
+        for (auto it = tree->begin(); it != tree->end(); ++it) {
+            attach(_hashTable, _size, it.key(), it.value());
+        }
+        tree->release();
+        delete tree;
+        _oldTable[_migrated] = nullptr;
+    }
+    _migrated++;
+}
+
+template<class V, class K, class Hash, class Eq, int Inline>
+void HashTable<V, K, Hash, Eq, Inline>::migrate(int buckets) {
+    if (!isMigrating()) return;
+    HASH_STAT(auto start = chrono::steady_clock::now());
+    for (int i = 0; i < buckets && _migrated < _oldSize; ++i) migrateBucket();
+
+    if (_migrated == _oldSize) {
+        delete[] _oldTable;
+        _oldTable = nullptr;
+        _oldSize = EMPTY_SIZE;
+        _migrated = 0;
+    }
+    HASH_STAT(_stats._resizeNanos += nanosSince(start));
+}
+
+template<class V, class K, class Hash, class Eq, int Inline>
+uint64_t *HashTable<V, K, Hash, Eq, Inline>::hashesOf(const K *keys, int n) {
+    auto hashes = new uint64_t[n];
+    for (int i = 0; i < n; ++i) hashes[i] = hashOf(keys[i]);
+    return hashes;
+}
+
+// Three stages, so every load is already in cache when the next one depends on it.
+template<class V, class K, class Hash, class Eq, int Inline>
+void HashTable<V, K, Hash, Eq, Inline>::prefetch(const uint64_t *hashes, int n, int i, int distance) {
+    if (i + 3 * distance < n) HASH_PREFETCH(&_hashTable[bucketOf(hashes[i + 3 * distance], _size)]);
+    if (i + 2 * distance < n) {
+        auto tree = _hashTable[bucketOf(hashes[i + 2 * distance], _size)];
+        if (tree) HASH_PREFETCH(tree);
+    }
+    if (i + distance < n) {
+        auto tree = _hashTable[bucketOf(hashes[i + distance], _size)];
+        if (tree) tree->prefetchRoot();
+    }
+}
 
-        auto array = tree->getValueSorted();
-        for (int j = 0; j < tree->getSize(); ++j) {
-            init(new_hash, array[j]->_key, array[j]->_value);
+template<class V, class K, class Hash, class Eq, int Inline>
+void HashTable<V, K, Hash, Eq, Inline>::getMany(const K *keys, int n, V *out, bool *found, int distance) {
+    if (distance < 0) throw HashIllegalInput();
+    if (n <= 0) return;
+    if (!hasBuckets()) {
+        for (int i = 0; i < n; ++i) {
+            auto value = findValue(keys[i]);
+            found[i] = value != nullptr;
+            if (value) out[i] = *value;
         }
-        delete[] array;
+        return;
     }
-    for (int i = 0; i < prev_size; ++i) {
-        if (_hashTable[i] != nullptr) { delete _hashTable[i]; }
+
+    auto hashes = hashesOf(keys, n);
+    for (int i = 0; i < distance && i < n; ++i) prefetch(hashes, n, i - distance, distance);
+
+    for (int i = 0; i < n; ++i) {
+        prefetch(hashes, n, i, distance);
+        auto node = lookup(keys[i], hashes[i]);
+        found[i] = node != nullptr;
+        if (node) out[i] = node->_value;
+    }
+    delete[] hashes;
+}
+
+template<class V, class K, class Hash, class Eq, int Inline>
+void HashTable<V, K, Hash, Eq, Inline>::insertMany(const K *keys, const V *values, int n, int distance) {
+    if (distance < 0) throw HashIllegalInput();
+    if (n <= 0) return;
+    grow(_counter + n);
+    if (!hasBuckets()) {
+        for (int i = 0; i < n; ++i) emplace(keys[i], values[i]);
+        return;
     }
-    delete[] _hashTable;
 
-    _hashTable = new_hash;
+    auto hashes = hashesOf(keys, n);
+    for (int i = 0; i < distance && i < n; ++i) prefetch(hashes, n, i - distance, distance);
+
+    try {
+        for (int i = 0; i < n; ++i) {
+            prefetch(hashes, n, i, distance);
+            emplaceHashed(hashes[i], keys[i], values[i]);
+        }
+    } catch (...) {
+        delete[] hashes;
+        throw;
+    }
+    delete[] hashes;
 }
 
-template<class V>
-bool HashTable<V>::includesKey(int key) {
-    if (isEmpty()) { return false; }
-    auto tree = _hashTable[hashFunction(key)];
-    return !(!tree || tree->getSize() == EMPTY_SIZE || !tree->includes(key));
+template<class V, class K, class Hash, class Eq, int Inline>
+template<class Q>
+bool HashTable<V, K, Hash, Eq, Inline>::includesKey(const Q &key) {
+    return findValue(key) != nullptr;
 }
 
-template<class V>
-void HashTable<V>::remove(int key) {
-    if (!includesKey(key)) return;
-    auto tree = _hashTable[hashFunction(key)];
-    tree->remove(key);
+template<class V, class K, class Hash, class Eq, int Inline>
+template<class Q>
+void HashTable<V, K, Hash, Eq, Inline>::remove(const Q &key) {
+    if (Inline > 0 && !hasBuckets()) {
+        int i = findInline(key);
+        if (i >= 0) removeInline(i);
+        return;
+    }
+    uint64_t hash = hashOf(key);
+    auto tree = findTree(hash);
+    if (!tree) return;
+
+    Node *prev = nullptr, *node = tree->find(hash);
+    while (node && !_eq(node->_key, key)) {
+        prev = node;
+        node = node->_next;
+    }
+    if (!node) return;
+
+    auto next = node->_next;
+    node->_next = nullptr;
+    if (prev) {
+        prev->_next = next;
+        delete node;
+    } else {
+        HASH_STAT(long rotations = tree->getRotations());
+        tree->remove(hash);
+        if (next) tree->insert(hash, next);
+        HASH_STAT(_stats._rotations += tree->getRotations() - rotations);
+    }
     _counter--;
-    if (_size >= 40 && _counter == _size / 4) { resize(true); }
+    migrate(HASH_MIGRATION_STEP);
+    if (_size >= MIN_SHRINK_SIZE && _counter <= _size * _minLoad && _size / 2 >= bucketsFor(_reserved)) {
+        resize(_size / 2);
+    }
 }
 
-template<class V>
-void HashTable<V>::init(AVLRankTree<int, Node> **array, int key, V value) {
-    int index = hashFunction(key);
+template<class V, class K, class Hash, class Eq, int Inline>
+void HashTable<V, K, Hash, Eq, Inline>::attach(Tree **array, int size, uint64_t hash, Node *node) {
+    int index = bucketOf(hash, size);
 
-    AVLRankTree<int, Node> *newTree = nullptr;
     if (!array[index]) {
-        newTree = new AVLRankTree<int, Node>();
-        array[index] = newTree;
+        array[index] = new Tree();
     }
-    newTree = array[index];
-    auto node = new Node(key, value);
-    newTree->insert(key, node);
+    HASH_STAT(long rotations = array[index]->getRotations());
+    array[index]->insert(hash, node);
+    HASH_STAT(_stats._rotations += array[index]->getRotations() - rotations);
 }
 
-template<class V>
-bool HashTable<V>::isEmpty() {
-    return _size <= EMPTY_SIZE;
+template<class V, class K, class Hash, class Eq, int Inline>
+bool HashTable<V, K, Hash, Eq, Inline>::isEmpty() {
+    return !hasBuckets() && _inlineCount == 0;
 }
 
-template<class V>
-int HashTable<V>::getSize() {
-    return isEmpty() ? EMPTY_SIZE : _size;
+template<class V, class K, class Hash, class Eq, int Inline>
+int HashTable<V, K, Hash, Eq, Inline>::getSize() {
+    return hasBuckets() ? _size : EMPTY_SIZE;
 }
 
-template<class V>
-void HashTable<V>::destroyHash(ValueDestroyFunction *f) {
+template<class V, class K, class Hash, class Eq, int Inline>
+int HashTable<V, K, Hash, Eq, Inline>::getCount() {
+    return _counter;
+}
+
+// Phase 0 walks the current table, phase 1 the old buckets not migrated yet, phase 2 is the end.
+// A table without buckets has its inline entries walked in phase 0, _bucket is the entry index.
+template<class V, class K, class Hash, class Eq, int Inline>
+void HashTable<V, K, Hash, Eq, Inline>::Iterator::settle() {
+    if (!_table->hasBuckets()) {
+        if (_bucket >= _table->_inlineCount) {
+            _phase = 2;
+            _bucket = -1;
+        }
+        return;
+    }
+    while (_phase < 2 && _node == TreeIterator()) {
+        auto array = _phase == 0 ? _table->_hashTable : _table->_oldTable;
+        int size = _phase == 0 ? _table->_size : _table->_oldSize;
+
+        if (++_bucket >= size) {
+            _phase++;
+            _bucket = _phase == 1 ? _table->_migrated - 1 : -1;
+            continue;
+        }
+        if (array[_bucket] != nullptr) _node = array[_bucket]->begin();
+    }
+    _entry = _phase < 2 ? _node.value() : nullptr;
+}
+
+template<class V, class K, class Hash, class Eq, int Inline>
+typename HashTable<V, K, Hash, Eq, Inline>::Iterator &HashTable<V, K, Hash, Eq, Inline>::Iterator::operator++() {
+    if (!_entry) {
+        ++_bucket;
+        settle();
+        return *this;
+    }
+    if (_entry->_next) {
+        _entry = _entry->_next;
+        return *this;
+    }
+    ++_node;
+    settle();
+    return *this;
+}
+
+template<class V, class K, class Hash, class Eq, int Inline>
+typename HashTable<V, K, Hash, Eq, Inline>::Iterator HashTable<V, K, Hash, Eq, Inline>::begin() {
+    Iterator it(this, 0, hasBuckets() ? -1 : 0);
+    it.settle();
+    return it;
+}
+
+template<class V, class K, class Hash, class Eq, int Inline>
+typename HashTable<V, K, Hash, Eq, Inline>::Iterator HashTable<V, K, Hash, Eq, Inline>::end() {
+    return Iterator(this, 2, -1);
+}
+
+template<class V, class K, class Hash, class Eq, int Inline>
+template<class F>
+void HashTable<V, K, Hash, Eq, Inline>::forEach(F f) {
+    for (auto it = begin(); it != end(); ++it) {
+        auto entry = *it;
+        f(entry.first, entry.second);
+    }
+}
+
+template<class V, class K, class Hash, class Eq, int Inline>
+void HashTable<V, K, Hash, Eq, Inline>::clear() {
     for (int i = 0; i < _size; ++i) {
         if (_hashTable[i] != nullptr) {
-            if (!_hashTable[i]->isEmpty()) {
-                auto sortedKeys = _hashTable[i]->getKeySorted();
-                for (int k = 0; k < _hashTable[i]->getSize(); ++k) {
-                    auto key = sortedKeys[k];
-                    auto value = _hashTable[i]->getValue(key)->_value;
-                    f->operator()(value);
-                }
-                delete[] sortedKeys;
-            }
             _hashTable[i]->destroy();
             delete _hashTable[i];
         }
     }
     if (_size > 0) delete[] _hashTable;
-}
\ No newline at end of file
+
+    for (int i = _migrated; i < _oldSize; ++i) {
+        if (_oldTable[i] != nullptr) {
+            _oldTable[i]->destroy();
+            delete _oldTable[i];
+        }
+    }
+    if (isMigrating()) delete[] _oldTable;
+
+    for (int i = 0; i < _inlineCount; ++i) {
+        inlineKeys()[i].~K();
+        inlineValues()[i].~V();
+    }
+    _inlineCount = 0;
+
+    _hashTable = nullptr;
+    _size = EMPTY_SIZE;
+    _counter = EMPTY_SIZE;
+    _oldTable = nullptr;
+    _oldSize = EMPTY_SIZE;
+    _migrated = 0;
+    rebuildFilter();
+}
+
+template<class V, class K, class Hash, class Eq, int Inline>
+void HashTable<V, K, Hash, Eq, Inline>::destroyHash(ValueDestroyFunction *f) {
+    for (auto it = begin(); it != end(); ++it) f->operator()((*it).second);
+    clear();
+}
+
+template<class V, class K, class Hash, class Eq, int Inline>
+void HashTable<V, K, Hash, Eq, Inline>::exportImage(const char *path) {
+    static_assert(is_same<K, int>::value, "the image format stores int keys");
+    static_assert(is_trivially_copyable<V>::value, "exported values are written raw to the file");
+
+    HashImageHeader header = HashImageHeader();
+    memcpy(header._magic, HASH_IMAGE_MAGIC, sizeof(header._magic));
+    header._version = HASH_IMAGE_VERSION;
+    header._valueSize = sizeof(V);
+    header._capacity = 2;
+    while (header._capacity < (uint64_t) _counter * 2) header._capacity *= 2;
+    header._count = (uint64_t) _counter;
+    header._slotsOffset = hashImageAlign(sizeof(HashImageHeader));
+    header._valuesOffset = hashImageAlign(header._slotsOffset + header._capacity * sizeof(HashImageSlot));
+
+    auto slots = new HashImageSlot[header._capacity]();
+    auto values = new char[header._count * sizeof(V) + 1];
+    uint32_t index = 0;
+    uint64_t mask = header._capacity - 1;
+    forEach([&](int key, const V &value) {
+        uint64_t i = hashImageSlot(key, header._capacity);
+        while (slots[i]._index != HASH_IMAGE_EMPTY_SLOT) i = (i + 1) & mask;
+        memcpy(values + (uint64_t) index * sizeof(V), &value, sizeof(V));
+        slots[i]._key = key;
+        slots[i]._index = ++index;
+    });
+
+    static const char padding[HASH_IMAGE_ALIGN] = {};
+    FILE *file = fopen(path, "wb");
+    bool ok = file != nullptr;
+    if (ok) {
+        uint64_t slotsEnd = header._slotsOffset + header._capacity * sizeof(HashImageSlot);
+        ok = fwrite(&header, sizeof(header), 1, file) == 1
+             && fwrite(padding, 1, header._slotsOffset - sizeof(header), file) == header._slotsOffset - sizeof(header)
+             && fwrite(slots, sizeof(HashImageSlot), header._capacity, file) == header._capacity
+             && fwrite(padding, 1, header._valuesOffset - slotsEnd, file) == header._valuesOffset - slotsEnd
+             && fwrite(values, sizeof(V), header._count, file) == header._count;
+        ok = fclose(file) == 0 && ok;
+    }
+    delete[] slots;
+    delete[] values;
+    if (!ok) throw HashImageError();
+}
+
+#ifdef HASH_TABLE_STATS
+template<class V, class K, class Hash, class Eq, int Inline>
+HashTableStats HashTable<V, K, Hash, Eq, Inline>::getStats() {
+    HashTableStats stats = HashTableStats();
+    stats.buckets = _size + _oldSize - _migrated;
+    stats.entries = _counter;
+
+    for (int t = 0; t < 2; ++t) {
+        auto array = t == 0 ? _hashTable : _oldTable;
+        int size = t == 0 ? _size : _oldSize;
+        for (int i = t == 0 ? 0 : _migrated; i < size; ++i) {
+            int chain = array[i] ? array[i]->getSize() : 0;
+            if (array[i]) {
+                stats.trees++;
+                if (array[i]->getHeight() > stats.deepestTree) stats.deepestTree = array[i]->getHeight();
+            }
+            if (chain > stats.longestChain) stats.longestChain = chain;
+            stats.occupancy[chain < HASH_STATS_HISTOGRAM ? chain : HASH_STATS_HISTOGRAM]++;
+        }
+    }
+
+    stats.resizes = _stats._resizes;
+    stats.resizeSeconds = _stats._resizeNanos / 1e9;
+    stats.rotations = _stats._rotations;
+    stats.bucketArrayBytes = (long) (_size + _oldSize) * (long) sizeof(Tree *);
+    stats.treeBytes = (long) stats.trees * (long) sizeof(Tree);
+    stats.nodeBytes = (long) (_counter - _inlineCount) * (long) (sizeof(Node) + Tree::getNodeBytes());
+    stats.filterBytes = _filter ? _filter->getBytes() : 0;
+    stats.hits = _stats._hits.load(memory_order_relaxed);
+    stats.misses = _stats._misses.load(memory_order_relaxed);
+    return stats;
+}
+#endif
+
+#endif /* HashTable_H_ */
@@ -0,0 +1,201 @@
+#ifndef INDEXEDMINHEAP_H
+#define INDEXEDMINHEAP_H
+
+#include<functional>
+#include<new>
+#include<utility>
+#include "MinHeap.hpp"
+
+/**
+ * Binary min heap of (id, key) pairs with ids in [0, n), e.g. graph vertices or timer slots.
+ * A position array maps every id to its heap slot, so decreaseKey, increaseKey and erase
+ * find the entry in O(1) and fix the heap in O(log n), without stale duplicates.
+ * The position array grows with the largest id inserted.
+ */
+template<class T = int, class Compare = less<T>>
+class IndexedMinHeap {
+    struct Entry {
+        T key;
+        int id;
+    };
+
+    Entry* heap_array;
+    int capacity;
+    int size;
+    int* position; // Heap slot by id, -1 when absent.
+    int ids;
+    Compare compare;
+private:
+
+    int parent(int i) { return (i - 1) / 2; }
+
+    int left(int i) { return (2 * i + 1); }
+
+    void place(int index, Entry&& entry) {
+        position[entry.id] = index;
+        heap_array[index] = std::move(entry);
+    }
+
+    // Moves the entry at index down to its place.
+    void swift(int index) {
+        Entry entry = std::move(heap_array[index]);
+        int l = left(index);
+        while (l < size) {
+            int smallest = l;
+            if (l + 1 < size && compare(heap_array[l + 1].key, heap_array[l].key)) { smallest = l + 1; }
+            if (!compare(heap_array[smallest].key, entry.key)) { break; }
+            place(index, std::move(heap_array[smallest]));
+            index = smallest;
+            l = left(index);
+        }
+        place(index, std::move(entry));
+    }
+
+    // Moves the entry at index up to its place.
+    void sift_up(int index) {
+        Entry entry = std::move(heap_array[index]);
+        while (index != 0 && compare(entry.key, heap_array[parent(index)].key)) {
+            place(index, std::move(heap_array[parent(index)]));
+            index = parent(index);
+        }
+        place(index, std::move(entry));
+    }
+
+    void increase_capacity() {
+        auto bigger = static_cast<Entry*>(operator new(sizeof(Entry) * 2 * capacity));
+
+        for (int i = 0; i < size; ++i) {
+            new(&bigger[i]) Entry(std::move(heap_array[i]));
+            heap_array[i].~Entry();
+        }
+        operator delete(heap_array);
+        capacity *= 2;
+        heap_array = bigger;
+    }
+
+    void reserve_ids(int n) {
+        if (n <= ids) { return; }
+        int count = ids * 2 > n ? ids * 2 : n;
+        auto bigger = new int[count];
+        for (int i = 0; i < count; ++i) { bigger[i] = i < ids ? position[i] : -1; }
+        delete[] position;
+        position = bigger;
+        ids = count;
+    }
+
+    // Slot of the id, throws HeapIndexOutOfRange when it isn't in the heap.
+    int slot(int id) {
+        if (!contains(id)) { throw HeapIndexOutOfRange(); }
+        return position[id];
+    }
+
+    // Removes the entry at index, the last entry takes its place.
+    void remove_at(int index) {
+        position[heap_array[index].id] = -1;
+        size--;
+        if (index != size) {
+            place(index, std::move(heap_array[size]));
+            if (index > 0 && compare(heap_array[index].key, heap_array[parent(index)].key)) {
+                sift_up(index);
+            } else {
+                swift(index);
+            }
+        }
+        heap_array[size].~Entry();
+    }
+
+public:
+
+    int getSize() { return size; }
+
+    bool isEmpty() { return size <= 0; }
+
+    /**
+     * @param cap - initial heap capacity.
+     * @param id_range - initial id range (default cap), ids past it grow the position array.
+     */
+    explicit IndexedMinHeap(int cap, int id_range = 0, const Compare &compare = Compare())
+            : ids(0), compare(compare) {
+        if (cap <= 0 || id_range < 0) { throw HeapIllegalInput(); }
+        size = 0;
+        capacity = cap;
+        heap_array = static_cast<Entry*>(operator new(sizeof(Entry) * cap));
+        position = nullptr;
+        reserve_ids(id_range > 0 ? id_range : cap);
+    }
+
+    IndexedMinHeap(const IndexedMinHeap &) = delete;
+
+    IndexedMinHeap &operator=(const IndexedMinHeap &) = delete;
+
+    ~IndexedMinHeap() {
+        for (int i = 0; i < size; ++i) { heap_array[i].~Entry(); }
+        operator delete(heap_array);
+        delete[] position;
+    }
+
+    bool contains(int id) { return id >= 0 && id < ids && position[id] >= 0; }
+
+    // Throws HeapIllegalInput when the id is negative or already in the heap.
+    void insert(int id, const T& key) {
+        if (id < 0 || contains(id)) { throw HeapIllegalInput(); }
+        reserve_ids(id + 1);
+        if (size == capacity) {
+            increase_capacity();
+        }
+
+        new(&heap_array[size]) Entry{key, id};
+        position[id] = size;
+        size++;
+        sift_up(size - 1);
+    }
+
+    // Throws HeapIndexOutOfRange when the id isn't in the heap.
+    const T& get_key(int id) { return heap_array[slot(id)].key; }
+
+    // Throws HeapIllegalInput when key is greater than the current key.
+    void decreaseKey(int id, const T& key) {
+        int index = slot(id);
+        if (compare(heap_array[index].key, key)) { throw HeapIllegalInput(); }
+        heap_array[index].key = key;
+        sift_up(index);
+    }
+
+    // Throws HeapIllegalInput when key is smaller than the current key.
+    void increaseKey(int id, const T& key) {
+        int index = slot(id);
+        if (compare(key, heap_array[index].key)) { throw HeapIllegalInput(); }
+        heap_array[index].key = key;
+        swift(index);
+    }
+
+    // Throws HeapIndexOutOfRange when the id isn't in the heap.
+    void erase(int id) { remove_at(slot(id)); }
+
+    const T& get_min() {
+        if (size <= 0)
+            throw HeapIsEmpty();
+        return heap_array[0].key;
+    }
+
+    int get_min_id() {
+        if (size <= 0)
+            throw HeapIsEmpty();
+        return heap_array[0].id;
+    }
+
+    void remove_min() {
+        if (size <= 0)
+            throw HeapIsEmpty();
+        remove_at(0);
+    }
+
+    // Removes the minimum and returns its id.
+    int extract_min() {
+        int id = get_min_id();
+        remove_at(0);
+        return id;
+    }
+};
+
+#endif //INDEXEDMINHEAP_H
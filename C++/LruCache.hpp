@@ -0,0 +1,340 @@
+#ifndef LruCache_H_
+#define LruCache_H_
+
+#include <stddef.h>
+#include "HashTable.hpp"
+#include "LinkedList.hpp"
+
+// Share of the capacity kept for the protected segment (SLRU, TWO_Q).
+#define LRU_PROTECTED_SHARE 0.8
+
+/**
+ * LRU: one recency list.
+ * SLRU: new entries start in a probation segment and move to the protected one on their
+ *       first hit, so a scan of one-time keys only flushes probation.
+ * TWO_Q: SLRU that also remembers the keys recently evicted from probation (ghosts),
+ *        a ghost that is put again is admitted straight into protected.
+ */
+enum class LruPolicy {
+    LRU, SLRU, TWO_Q
+};
+
+// Default weight, the capacity counts entries.
+template<class K, class V>
+struct LruEntryWeight {
+    size_t operator()(const K &, const V &) const { return 1; }
+};
+
+/**
+ * Cache of at most `capacity` weight, the least recently used entries are evicted first.
+ * get/put/remove are O(1): a HashTable indexes the nodes of intrusive doubly linked
+ * recency lists (ListNode prev/next), a touch relinks the node without searching the list.
+ * Weigh(key, value) gives the weight of an entry, e.g. its size in bytes to bound the memory.
+ */
+template<class K, class V, class Weigh = LruEntryWeight<K, V>, class Hash = HashMix<K>, class Eq = equal_to<>>
+class LruCache {
+private:
+    enum Segment {
+        PROBATION, PROTECTED
+    };
+
+    struct Entry {
+        K _key;
+        V _value;
+        size_t _weight;
+        Segment _segment;
+    };
+
+    typedef ListNode<Entry> Node;
+
+    // Recency list, head is the most recently used.
+    template<class T>
+    struct Recency {
+        ListNode<T> *_head = nullptr;
+        ListNode<T> *_tail = nullptr;
+        size_t _weight = 0;
+
+        void pushFront(ListNode<T> *node);
+
+        void unlink(ListNode<T> *node);
+    };
+
+    HashTable<Node *, K, Hash, Eq> _index;
+    Recency<Entry> _segments[2];
+    size_t _capacity;
+    LruPolicy _policy;
+    Weigh _weigh;
+
+    // TWO_Q: keys evicted from probation, at most as many as the cached entries.
+    HashTable<ListNode<K> *, K, Hash, Eq> _ghostIndex;
+    Recency<K> _ghosts;
+
+    long _hits;
+    long _misses;
+
+    size_t protectedCapacity() { return _policy == LruPolicy::LRU ? 0 : (size_t) (_capacity * LRU_PROTECTED_SHARE); }
+
+    void touch(Node *node);
+
+    void link(Node *node, Segment segment);
+
+    void unlink(Node *node);
+
+    void evict();
+
+    void remember(const K &key);
+
+    bool forget(const K &key);
+
+    void clearGhosts();
+
+public:
+    explicit LruCache(size_t capacity, LruPolicy policy = LruPolicy::LRU, const Weigh &weigh = Weigh(),
+                      const Hash &hash = Hash(), const Eq &eq = Eq());
+
+    LruCache(const LruCache &) = delete;
+
+    LruCache &operator=(const LruCache &) = delete;
+
+    ~LruCache();
+
+    /**
+     * Pointer to the cached value and marks it as most recently used, nullptr on a miss.
+     * Valid until the entry is evicted or removed.
+     */
+    template<class Q>
+    V *get(const Q &key);
+
+    // Like get, without touching the entry or counting a hit/miss.
+    template<class Q>
+    bool contains(const Q &key);
+
+    /**
+     * Inserts or replaces the value, then evicts until the weight fits the capacity.
+     * An entry heavier than the whole capacity is not cached.
+     */
+    void put(const K &key, V value);
+
+    // @return false when the key isn't cached.
+    template<class Q>
+    bool remove(const Q &key);
+
+    void clear();
+
+    int getCount();
+
+    // Sum of the cached entries' weights.
+    size_t getWeight();
+
+    size_t getCapacity();
+
+    long getHits();
+
+    long getMisses();
+};
+
+template<class K, class V, class Weigh, class Hash, class Eq>
+template<class T>
+void LruCache<K, V, Weigh, Hash, Eq>::Recency<T>::pushFront(ListNode<T> *node) {
+    node->prev = nullptr;
+    node->next = _head;
+    if (_head) _head->prev = node;
+    else _tail = node;
+    _head = node;
+}
+
+template<class K, class V, class Weigh, class Hash, class Eq>
+template<class T>
+void LruCache<K, V, Weigh, Hash, Eq>::Recency<T>::unlink(ListNode<T> *node) {
+    if (node->prev) node->prev->next = node->next;
+    else _head = node->next;
+    if (node->next) node->next->prev = node->prev;
+    else _tail = node->prev;
+    node->prev = node->next = nullptr;
+}
+
+template<class K, class V, class Weigh, class Hash, class Eq>
+LruCache<K, V, Weigh, Hash, Eq>::LruCache(size_t capacity, LruPolicy policy, const Weigh &weigh,
+                                          const Hash &hash, const Eq &eq)
+        : _index(hash, eq), _capacity(capacity), _policy(policy), _weigh(weigh), _ghostIndex(hash, eq),
+          _hits(0), _misses(0) {}
+
+template<class K, class V, class Weigh, class Hash, class Eq>
+LruCache<K, V, Weigh, Hash, Eq>::~LruCache() {
+    clear();
+}
+
+template<class K, class V, class Weigh, class Hash, class Eq>
+void LruCache<K, V, Weigh, Hash, Eq>::link(Node *node, Segment segment) {
+    node->data._segment = segment;
+    _segments[segment].pushFront(node);
+    _segments[segment]._weight += node->data._weight;
+}
+
+template<class K, class V, class Weigh, class Hash, class Eq>
+void LruCache<K, V, Weigh, Hash, Eq>::unlink(Node *node) {
+    auto &segment = _segments[node->data._segment];
+    segment.unlink(node);
+    segment._weight -= node->data._weight;
+}
+
+// A hit: LRU and protected entries move to the front, probation entries are promoted.
+// Protected overflow is demoted back to the front of probation.
+template<class K, class V, class Weigh, class Hash, class Eq>
+void LruCache<K, V, Weigh, Hash, Eq>::touch(Node *node) {
+    unlink(node);
+    link(node, _policy == LruPolicy::LRU ? PROBATION : PROTECTED);
+
+    auto &hot = _segments[PROTECTED];
+    while (hot._weight > protectedCapacity() && hot._tail != node) {
+        auto demoted = hot._tail;
+        unlink(demoted);
+        link(demoted, PROBATION);
+    }
+}
+
+template<class K, class V, class Weigh, class Hash, class Eq>
+void LruCache<K, V, Weigh, Hash, Eq>::evict() {
+    while (_segments[PROBATION]._weight + _segments[PROTECTED]._weight > _capacity) {
+        auto victim = _segments[PROBATION]._tail ? _segments[PROBATION]._tail : _segments[PROTECTED]._tail;
+        unlink(victim);
+        _index.remove(victim->data._key);
+        if (_policy == LruPolicy::TWO_Q && victim->data._segment == PROBATION) remember(victim->data._key);
+        delete victim;
+    }
+}
+
+template<class K, class V, class Weigh, class Hash, class Eq>
+void LruCache<K, V, Weigh, Hash, Eq>::remember(const K &key) {
+    if (_ghostIndex.includesKey(key)) return;
+    auto ghost = new ListNode<K>{key, nullptr, nullptr};
+    _ghosts.pushFront(ghost);
+    _ghostIndex.insert(key, ghost);
+
+    while (_ghostIndex.getCount() > _index.getCount() && _ghosts._tail) {
+        auto oldest = _ghosts._tail;
+        _ghosts.unlink(oldest);
+        _ghostIndex.remove(oldest->data);
+        delete oldest;
+    }
+}
+
+template<class K, class V, class Weigh, class Hash, class Eq>
+bool LruCache<K, V, Weigh, Hash, Eq>::forget(const K &key) {
+    auto ghost = _ghostIndex.find(key);
+    if (!ghost) return false;
+    auto node = *ghost;
+    _ghosts.unlink(node);
+    _ghostIndex.remove(key);
+    delete node;
+    return true;
+}
+
+template<class K, class V, class Weigh, class Hash, class Eq>
+template<class Q>
+V *LruCache<K, V, Weigh, Hash, Eq>::get(const Q &key) {
+    auto found = _index.find(key);
+    if (!found) {
+        _misses++;
+        return nullptr;
+    }
+    _hits++;
+    touch(*found);
+    return &(*found)->data._value;
+}
+
+template<class K, class V, class Weigh, class Hash, class Eq>
+template<class Q>
+bool LruCache<K, V, Weigh, Hash, Eq>::contains(const Q &key) {
+    return _index.includesKey(key);
+}
+
+template<class K, class V, class Weigh, class Hash, class Eq>
+void LruCache<K, V, Weigh, Hash, Eq>::put(const K &key, V value) {
+    size_t weight = _weigh(key, value);
+    auto found = _index.find(key);
+
+    if (found) {
+        auto node = *found;
+        if (weight > _capacity) {
+            remove(key);
+            return;
+        }
+        unlink(node);
+        node->data._value = std::move(value);
+        node->data._weight = weight;
+        link(node, node->data._segment);
+        touch(node);
+    } else {
+        if (weight > _capacity) return;
+        bool ghost = _policy == LruPolicy::TWO_Q && forget(key);
+        auto node = new Node{Entry{key, std::move(value), weight, PROBATION}, nullptr, nullptr};
+        _index.insert(key, node);
+        link(node, PROBATION);
+        if (ghost) touch(node);
+    }
+    evict();
+}
+
+template<class K, class V, class Weigh, class Hash, class Eq>
+template<class Q>
+bool LruCache<K, V, Weigh, Hash, Eq>::remove(const Q &key) {
+    auto found = _index.find(key);
+    if (!found) return false;
+    auto node = *found;
+    unlink(node);
+    _index.remove(key);
+    delete node;
+    return true;
+}
+
+template<class K, class V, class Weigh, class Hash, class Eq>
+void LruCache<K, V, Weigh, Hash, Eq>::clearGhosts() {
+    while (_ghosts._head) {
+        auto ghost = _ghosts._head;
+        _ghosts.unlink(ghost);
+        delete ghost;
+    }
+    _ghostIndex.clear();
+}
+
+template<class K, class V, class Weigh, class Hash, class Eq>
+void LruCache<K, V, Weigh, Hash, Eq>::clear() {
+    for (auto &segment : _segments) {
+        while (segment._head) {
+            auto node = segment._head;
+            segment.unlink(node);
+            delete node;
+        }
+        segment._weight = 0;
+    }
+    _index.clear();
+    clearGhosts();
+}
+
+template<class K, class V, class Weigh, class Hash, class Eq>
+int LruCache<K, V, Weigh, Hash, Eq>::getCount() {
+    return _index.getCount();
+}
+
+template<class K, class V, class Weigh, class Hash, class Eq>
+size_t LruCache<K, V, Weigh, Hash, Eq>::getWeight() {
+    return _segments[PROBATION]._weight + _segments[PROTECTED]._weight;
+}
+
+template<class K, class V, class Weigh, class Hash, class Eq>
+size_t LruCache<K, V, Weigh, Hash, Eq>::getCapacity() {
+    return _capacity;
+}
+
+template<class K, class V, class Weigh, class Hash, class Eq>
+long LruCache<K, V, Weigh, Hash, Eq>::getHits() {
+    return _hits;
+}
+
+template<class K, class V, class Weigh, class Hash, class Eq>
+long LruCache<K, V, Weigh, Hash, Eq>::getMisses() {
+    return _misses;
+}
+
+#endif /* LruCache_H_ */
@@ -0,0 +1,134 @@
+#ifndef MappedHashTable_H_
+#define MappedHashTable_H_
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <type_traits>
+#include "HashImage.hpp"
+#include "HashTable.hpp"
+
+/**
+ * Read-only HashTable served straight from a memory mapped image (see HashTable::exportImage).
+ * Opening it only maps the file, nothing is deserialized; the pages are loaded on demand
+ * and shared through the page cache by all the processes mapping the same file.
+ */
+template<class V>
+class MappedHashTable {
+private:
+    static_assert(is_trivially_copyable<V>::value, "MappedHashTable values are read raw from the file");
+
+    void *_mapping;
+    size_t _length;
+    const HashImageHeader *_header;
+    const HashImageSlot *_slots;
+    const char *_values;
+
+    const HashImageSlot *findSlot(int key) const;
+
+public:
+    explicit MappedHashTable(const char *path);
+
+    MappedHashTable(const MappedHashTable &) = delete;
+
+    MappedHashTable &operator=(const MappedHashTable &) = delete;
+
+    ~MappedHashTable();
+
+    V getValue(int key) const;
+
+    // Pointer into the mapping, or nullptr when the key doesn't exist.
+    const V *find(int key) const;
+
+    bool includesKey(int key) const;
+
+    int getCount() const;
+};
+
+template<class V>
+MappedHashTable<V>::MappedHashTable(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) throw HashImageError();
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t) info.st_size < sizeof(HashImageHeader)) {
+        close(fd);
+        throw HashImageError();
+    }
+    _length = (size_t) info.st_size;
+    _mapping = mmap(nullptr, _length, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (_mapping == MAP_FAILED) throw HashImageError();
+
+    _header = static_cast<const HashImageHeader *>(_mapping);
+    uint64_t capacity = _header->_capacity;
+    uint64_t count = _header->_count;
+    uint64_t slotsOffset = _header->_slotsOffset;
+    uint64_t valuesOffset = _header->_valuesOffset;
+    // Every size is checked against the room left before it is added, so a corrupt
+    // header can't wrap the sums around and point the sections outside the mapping.
+    bool valid = memcmp(_header->_magic, HASH_IMAGE_MAGIC, sizeof(_header->_magic)) == 0
+                 && _header->_version == HASH_IMAGE_VERSION
+                 && _header->_valueSize == sizeof(V)
+                 && capacity > 0 && (capacity & (capacity - 1)) == 0
+                 && count < capacity
+                 && slotsOffset >= sizeof(HashImageHeader) && slotsOffset % alignof(HashImageSlot) == 0
+                 && slotsOffset <= _length
+                 && capacity <= (_length - slotsOffset) / sizeof(HashImageSlot)
+                 && valuesOffset >= slotsOffset + capacity * sizeof(HashImageSlot)
+                 && valuesOffset % alignof(V) == 0
+                 && valuesOffset <= _length
+                 && count <= (_length - valuesOffset) / sizeof(V);
+    if (!valid) {
+        munmap(_mapping, _length);
+        throw HashImageError();
+    }
+
+    _slots = reinterpret_cast<const HashImageSlot *>(static_cast<const char *>(_mapping) + _header->_slotsOffset);
+    _values = static_cast<const char *>(_mapping) + _header->_valuesOffset;
+}
+
+template<class V>
+MappedHashTable<V>::~MappedHashTable() {
+    munmap(_mapping, _length);
+}
+
+template<class V>
+const HashImageSlot *MappedHashTable<V>::findSlot(int key) const {
+    uint64_t mask = _header->_capacity - 1;
+    uint64_t i = hashImageSlot(key, _header->_capacity);
+    for (uint64_t probes = 0; probes < _header->_capacity; ++probes, i = (i + 1) & mask) {
+        const HashImageSlot *slot = &_slots[i];
+        if (slot->_index == HASH_IMAGE_EMPTY_SLOT) return nullptr;
+        if (slot->_key == key) return slot;
+    }
+    return nullptr;
+}
+
+template<class V>
+const V *MappedHashTable<V>::find(int key) const {
+    auto slot = findSlot(key);
+    if (!slot || slot->_index > _header->_count) return nullptr;
+    return reinterpret_cast<const V *>(_values + (slot->_index - 1) * sizeof(V));
+}
+
+template<class V>
+V MappedHashTable<V>::getValue(int key) const {
+    auto value = find(key);
+    if (!value) throw HashKeyDoesNotExist();
+    return *value;
+}
+
+template<class V>
+bool MappedHashTable<V>::includesKey(int key) const {
+    return find(key) != nullptr;
+}
+
+template<class V>
+int MappedHashTable<V>::getCount() const {
+    return (int) _header->_count;
+}
+
+#endif /* MappedHashTable_H_ */
@@ -3,6 +3,10 @@
 
 #include<iostream>
 #include<climits>
+#include<functional>
+#include<iterator>
+#include<new>
+#include<utility>
 
 using namespace std;
 
@@ -15,10 +19,16 @@ class HeapIndexOutOfRange : public exception {
 class HeapIllegalInput : public exception {
 };
 
+/**
+ * Binary heap, the minimum by Compare (less: smallest first) on top.
+ * Sifts move a hole instead of swapping: every level costs one move.
+ */
+template<class T = int, class Compare = less<T>>
 class MinHeap {
-    int* heap_array;
+    T* heap_array;
     int capacity;
     int size;
+    Compare compare;
 private:
 
     int parent(int i) { return (i - 1) / 2; }
@@ -27,33 +37,65 @@ private:
 
     int right(int i) { return (2 * i + 2); }
 
-    void swap(int* x, int* y) {
-        int temp = *x;
-        *x = *y;
-        *y = temp;
-    }
-
+    // Moves the element at index down to its place.
     void swift(int index) {
+        T value = std::move(heap_array[index]);
         int l = left(index);
-        int r = right(index);
-        int smallest = index;
-        if (l < size && heap_array[l] < heap_array[index]) { smallest = l; }
-        if (r < size && heap_array[r] < heap_array[smallest]) { smallest = r; }
-        if (smallest != index) {
-            swap(&heap_array[index], &heap_array[smallest]);
-            swift(smallest);
+        while (l < size) {
+            int smallest = l;
+            if (l + 1 < size && compare(heap_array[l + 1], heap_array[l])) { smallest = l + 1; }
+            if (!compare(heap_array[smallest], value)) { break; }
+            heap_array[index] = std::move(heap_array[smallest]);
+            index = smallest;
+            l = left(index);
+        }
+        heap_array[index] = std::move(value);
+    }
+
+    // Moves the element at index up to its place.
+    void sift_up(int index) {
+        T value = std::move(heap_array[index]);
+        while (index != 0 && compare(value, heap_array[parent(index)])) {
+            heap_array[index] = std::move(heap_array[parent(index)]);
+            index = parent(index);
         }
+        heap_array[index] = std::move(value);
     }
 
-    void increase_capacity() {
-        auto bigger = new int[2 * capacity];
+    static T* allocate(int cap) { return static_cast<T*>(operator new(sizeof(T) * cap)); }
+
+    void increase_capacity() { reserve(2 * capacity); }
 
-        for (int i = 0; i < capacity; ++i) {
-            bigger[i] = heap_array[i];
+    // Floyd: sifts down every parent, the last one first. O(n), most nodes are near the leaves.
+    void heapify() {
+        for (int i = size / 2 - 1; i >= 0; --i) {
+            swift(i);
         }
-        delete[]heap_array;
-        capacity *= 2;
-        heap_array = bigger;
+    }
+
+    // Moves the hole at index down to a leaf by the smaller child, returns the leaf.
+    int hole_to_leaf(int index) {
+        int l = left(index);
+        while (l < size) {
+            int smallest = l;
+            if (l + 1 < size && compare(heap_array[l + 1], heap_array[l])) { smallest = l + 1; }
+            heap_array[index] = std::move(heap_array[smallest]);
+            index = smallest;
+            l = left(index);
+        }
+        return index;
+    }
+
+    // The hole left by the root goes down to a leaf, then the last element moves in and up.
+    // It usually belongs near the bottom, so this saves the compare against it on every level.
+    void remove_root() {
+        size--;
+        int index = hole_to_leaf(0);
+        if (index != size) {
+            heap_array[index] = std::move(heap_array[size]);
+            sift_up(index);
+        }
+        heap_array[size].~T();
     }
 
 public:
@@ -62,70 +104,125 @@ public:
 
     bool isEmpty() { return size <= 0; }
 
-    MinHeap(int cap) {
+    explicit MinHeap(int cap, const Compare &compare = Compare()) : compare(compare) {
         if (cap <= 0) { throw HeapIllegalInput(); }
         size = 0;
         capacity = cap;
-        heap_array = new int[cap];
+        heap_array = allocate(cap);
     }
 
-    ~MinHeap() { delete[]heap_array; }
+    MinHeap(const MinHeap &) = delete;
+
+    MinHeap &operator=(const MinHeap &) = delete;
+
+    ~MinHeap() {
+        for (int i = 0; i < size; ++i) { heap_array[i].~T(); }
+        operator delete(heap_array);
+    }
 
-    MinHeap(int size, int* array) {
-        this->size = size;
-        capacity = this->size;
-        heap_array = new int[this->size];
-        for (int i = 0; i < this->size; ++i) {
-            insert(array[i]);
+    // Builds the heap from the array in O(n).
+    MinHeap(int size, const T* array, const Compare &compare = Compare()) : MinHeap(array, array + size, compare) {}
+
+    // Builds the heap from the range in O(n).
+    template<class It>
+    MinHeap(It first, It last, const Compare &compare = Compare()) : compare(compare) {
+        auto n = distance(first, last);
+        if (n < 0) { throw HeapIllegalInput(); }
+        size = 0;
+        capacity = n > 0 ? (int) n : 1;
+        heap_array = allocate(capacity);
+        for (; first != last; ++first) {
+            new(&heap_array[size]) T(*first);
+            size++;
+        }
+        heapify();
+    }
+
+    // Makes room for cap elements, never shrinks.
+    void reserve(int cap) {
+        if (cap <= capacity) { return; }
+        auto bigger = allocate(cap);
+
+        for (int i = 0; i < size; ++i) {
+            new(&bigger[i]) T(std::move(heap_array[i]));
+            heap_array[i].~T();
+        }
+        operator delete(heap_array);
+        capacity = cap;
+        heap_array = bigger;
+    }
+
+    /**
+     * Inserts the range. When it's at least as large as the heap the whole array is
+     * heapified in O(n), otherwise every new element is sifted up.
+     */
+    template<class It>
+    void pushRange(It first, It last) {
+        int old_size = size;
+        auto n = distance(first, last);
+        reserve(size + (int) n);
+        for (; first != last; ++first) {
+            new(&heap_array[size]) T(*first);
+            size++;
+        }
+        if (n >= old_size) {
+            heapify();
+        } else {
+            for (int i = old_size; i < size; ++i) {
+                sift_up(i);
+            }
         }
     }
 
     void remove_min() {
         if (size <= 0)
             throw HeapIsEmpty();
-        if (size == 1) {
-            size--;
-        }
+        remove_root();
+    }
 
-        heap_array[0] = heap_array[size - 1];
-        size--;
-        swift(0);
+    const T& get_min() {
+        if (size <= 0)
+            throw HeapIsEmpty();
+        return heap_array[0];
     }
 
-    int get_min() { return heap_array[0]; }
+    void insert(const T& k) { emplace(k); }
+
+    void push(T&& k) { emplace(std::move(k)); }
 
-    void insert(int k) {
+    // Constructs the element in place at the end of the array, then sifts it up.
+    template<class... Args>
+    void emplace(Args&&... args) {
         if (size == capacity) {
             increase_capacity();
         }
 
+        new(&heap_array[size]) T(std::forward<Args>(args)...);
         size++;
-        int i = size - 1;
-        heap_array[i] = k;
-
-        while (i != 0 && heap_array[parent(i)] > heap_array[i]) {
-            swap(&heap_array[i], &heap_array[parent(i)]);
-            i = parent(i);
-        }
+        sift_up(size - 1);
     }
 
-    int extract_min() {
+    // Removes the minimum and returns it, moved out of the array.
+    T pop() {
         if (size <= 0)
             throw HeapIsEmpty();
-        if (size == 1) {
-            size--;
-            return heap_array[0];
-        }
-
-        // Store the minimum value, and remove it from heap
-        int root = heap_array[0];
-        heap_array[0] = heap_array[size - 1];
-        size--;
-        swift(0);
+        T root = std::move(heap_array[0]);
+        remove_root();
         return root;
+    }
 
+    T extract_min() { return pop(); }
 
+    // Replaces the minimum by k in one pass (like remove_root, without the last element), returns the old minimum.
+    T replace_min(T k) {
+        if (size <= 0)
+            throw HeapIsEmpty();
+        T root = std::move(heap_array[0]);
+        int index = hole_to_leaf(0);
+        heap_array[index] = std::move(k);
+        sift_up(index);
+        return root;
     }
 };
 
-#endif //OASIS_MINHEAP_H
\ No newline at end of file
+#endif //OASIS_MINHEAP_H
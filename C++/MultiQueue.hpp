@@ -0,0 +1,147 @@
+#ifndef MULTIQUEUE_H
+#define MULTIQUEUE_H
+
+#include<stdint.h>
+#include<functional>
+#include<mutex>
+#include<thread>
+#include "MinHeap.hpp"
+
+// Heaps per thread.
+#define MULTIQUEUE_FACTOR 2
+// Random try_lock attempts before an operation waits for a lock.
+#define MULTIQUEUE_ATTEMPTS 8
+
+/**
+ * Concurrent relaxed priority queue (MultiQueue): c * threads MinHeaps, each behind its own lock.
+ * insert pushes to a random heap. extract_min locks two random heaps and pops the smaller of
+ * their minimums. A busy heap isn't waited for, another random one is tried instead.
+ *
+ * Relaxation: extract_min returns a small element, not always the smallest. With m heaps
+ * the rank of the returned element among all the queued ones is O(m) in expectation
+ * (the two-choice process keeps the heaps' minimums balanced), and elements pushed by
+ * one thread may come out in a different order. Nothing is lost or returned twice.
+ * extract_min returns false only after scanning every heap and finding them empty;
+ * concurrent inserts may land in a heap already scanned.
+ */
+template<class T = int, class Compare = less<T>>
+class MultiQueue {
+    // A heap per cache line, so locking one heap doesn't invalidate its neighbours.
+    struct alignas(64) Queue {
+        mutex lock;
+        MinHeap<T, Compare>* heap;
+    };
+
+    Queue* queues;
+    int count;
+    Compare compare;
+private:
+
+    // Per thread xorshift, seeded from the thread id.
+    static uint64_t next_random() {
+        thread_local uint64_t state = hash<thread::id>()(this_thread::get_id()) * 0x9E3779B97F4A7C15ULL | 1;
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+
+    int random_queue() { return (int) (((next_random() >> 32) * (uint64_t) count) >> 32); }
+
+    // Locks both heaps, or none. Returns false when either is busy.
+    bool try_lock_pair(Queue& a, Queue& b) {
+        if (!a.lock.try_lock()) { return false; }
+        if (&a == &b || b.lock.try_lock()) { return true; }
+        a.lock.unlock();
+        return false;
+    }
+
+    // Pops the smaller minimum of the two locked heaps into out, then unlocks them.
+    bool pop_better(Queue& a, Queue& b, T& out) {
+        Queue* best = nullptr;
+        if (!a.heap->isEmpty()) { best = &a; }
+        if (!b.heap->isEmpty() && (!best || compare(b.heap->get_min(), best->heap->get_min()))) { best = &b; }
+        if (best) { out = best->heap->pop(); }
+        a.lock.unlock();
+        if (&a != &b) { b.lock.unlock(); }
+        return best != nullptr;
+    }
+
+public:
+
+    /**
+     * @param threads - threads expected to use the queue, MULTIQUEUE_FACTOR heaps per thread.
+     * @param factor - heaps per thread, more heaps mean less contention and a larger rank error.
+     */
+    explicit MultiQueue(int threads, int factor = MULTIQUEUE_FACTOR, const Compare &compare = Compare())
+            : compare(compare) {
+        if (threads <= 0 || factor <= 0) { throw HeapIllegalInput(); }
+        count = threads * factor;
+        queues = new Queue[count];
+        for (int i = 0; i < count; ++i) {
+            queues[i].heap = new MinHeap<T, Compare>(16, compare);
+        }
+    }
+
+    MultiQueue(const MultiQueue &) = delete;
+
+    MultiQueue &operator=(const MultiQueue &) = delete;
+
+    ~MultiQueue() {
+        for (int i = 0; i < count; ++i) {
+            delete queues[i].heap;
+        }
+        delete[] queues;
+    }
+
+    void insert(const T& k) {
+        for (int attempt = 0; attempt < MULTIQUEUE_ATTEMPTS; ++attempt) {
+            auto& queue = queues[random_queue()];
+            if (queue.lock.try_lock()) {
+                queue.heap->insert(k);
+                queue.lock.unlock();
+                return;
+            }
+        }
+        auto& queue = queues[random_queue()];
+        lock_guard<mutex> guard(queue.lock);
+        queue.heap->insert(k);
+    }
+
+    /**
+     * Pops a small element (see the relaxation above) into out.
+     * @return false when all the heaps were found empty.
+     */
+    bool extract_min(T& out) {
+        for (int attempt = 0; attempt < MULTIQUEUE_ATTEMPTS; ++attempt) {
+            auto& a = queues[random_queue()];
+            auto& b = queues[random_queue()];
+            if (try_lock_pair(a, b) && pop_better(a, b, out)) { return true; }
+        }
+        // Mostly empty or contended: every heap in turn.
+        for (int i = 0; i < count; ++i) {
+            lock_guard<mutex> guard(queues[i].lock);
+            if (!queues[i].heap->isEmpty()) {
+                out = queues[i].heap->pop();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    int getQueueCount() { return count; }
+
+    // Sum of the heaps' sizes, every heap is read under its own lock (not a global snapshot).
+    int getSize() {
+        int size = 0;
+        for (int i = 0; i < count; ++i) {
+            lock_guard<mutex> guard(queues[i].lock);
+            size += queues[i].heap->getSize();
+        }
+        return size;
+    }
+
+    bool isEmpty() { return getSize() == 0; }
+};
+
+#endif //MULTIQUEUE_H
@@ -0,0 +1,461 @@
+#ifndef PerfectHashTable_H_
+#define PerfectHashTable_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <new>
+#include <thread>
+#include <vector>
+#include "HashTable.hpp"
+
+// Keys per partition, every partition is built independently (and in parallel).
+#define PERFECT_PARTITION_KEYS 100000
+// Buckets per partition: PERFECT_BUCKETS_C * keys / log2(keys).
+#define PERFECT_BUCKETS_C 5.0
+// Keys / positions of a partition, the positions past the keys are remapped to the free ones.
+#define PERFECT_ALPHA 0.99
+// 60% of the keys go to 30% of the buckets (the dense buckets get the small pilots).
+#define PERFECT_DENSE_KEYS 0.6
+#define PERFECT_DENSE_BUCKETS 0.3
+#define PERFECT_MAX_PILOT (1 << 24)
+// Pilots are stored in a byte, this one marks a pilot kept in the exception list.
+#define PERFECT_PILOT_ESCAPE 255
+#define PERFECT_BUCKET_SEED 0x9E3779B97F4A7C15ULL
+#define PERFECT_PILOT_MUL 0xC2B2AE3D27D4EB4FULL
+
+class PerfectHashBuildError : public exception {
+};
+
+/**
+ * Immutable table over a fixed key set, indexed by a minimal perfect hash function
+ * (PTHash style): every key maps to its own slot of an array of exactly n entries,
+ * a lookup reads a few bits of metadata and then probes exactly one slot.
+ *
+ * The keys are split into partitions. In a partition the keys are hashed into buckets
+ * and every bucket gets the smallest pilot that sends all its keys to free positions,
+ * the largest buckets first. A pilot takes a byte, the few (~0.5%) that don't fit are
+ * binary searched in a sorted exception list. With the remap of the positions past the
+ * end of the partitions that is about 3 bits per key.
+ *
+ * Built from a HashTable by HashTable::buildPerfect, or from a range of (key, value) pairs.
+ */
+template<class V, class K = int, class Hash = HashMix<K>, class Eq = equal_to<>>
+class PerfectHashTable {
+private:
+    struct Entry {
+        K _key;
+        V _value;
+    };
+
+    struct Partition {
+        uint32_t _firstBucket; // Index of the partition's first pilot.
+        uint32_t _base; // First slot.
+        uint32_t _count;
+        uint32_t _positions;
+        uint32_t _buckets;
+        uint32_t _free; // Offset of the partition's remap in _free.
+    };
+
+    Entry *_entries;
+    int _counter;
+    Partition *_partitions;
+    int _partitionCount;
+    unsigned char *_pilots;
+    long _bucketCount;
+    // Sorted by bucket, the pilots >= PERFECT_PILOT_ESCAPE.
+    uint32_t *_exceptionBuckets;
+    uint32_t *_exceptionPilots;
+    int _exceptionCount;
+    uint32_t *_free;
+    long _freeCount;
+    Hash _hash;
+    Eq _eq;
+
+    template<class Q>
+    uint64_t hashOf(const Q &key) const { return (uint64_t) _hash(key); }
+
+    static uint32_t fastRange(uint32_t x, uint32_t range) { return (uint32_t) (((uint64_t) x * range) >> 32); }
+
+    static uint32_t bucketOf(uint64_t mixed, uint32_t buckets);
+
+    static uint32_t positionOf(uint64_t hash, uint64_t pilot, uint32_t positions) {
+        return fastRange((uint32_t) (hashMix(hash ^ (pilot * PERFECT_PILOT_MUL), HASH_MIX_P1) >> 32), positions);
+    }
+
+    // Slot of the hash code, or -1 when no key can have it.
+    int slotOf(uint64_t hash) const;
+
+    void build(int n, const uint64_t *hashes, const K *const *keys, const V *const *values, int threads);
+
+    static void buildPartition(const uint64_t *hashes, const int *keys, int n, vector<uint32_t> &pilots,
+                               vector<uint32_t> &positions, vector<uint32_t> &free);
+
+    template<class V2, class K2, class Hash2, class Eq2, int Inline>
+    friend class HashTable;
+
+    PerfectHashTable(int n, const uint64_t *hashes, const K *const *keys, const V *const *values, int threads,
+                     const Hash &hash, const Eq &eq);
+
+public:
+    /**
+     * @param first, last - range of pairs (key, value) with distinct keys.
+     * @param threads - build threads, 0 for one per hardware thread.
+     */
+    template<class It>
+    PerfectHashTable(It first, It last, int threads = 0, const Hash &hash = Hash(), const Eq &eq = Eq());
+
+    PerfectHashTable(const PerfectHashTable &) = delete;
+
+    PerfectHashTable &operator=(const PerfectHashTable &) = delete;
+
+    ~PerfectHashTable();
+
+    template<class Q>
+    V getValue(const Q &key) const;
+
+    // Pointer to the value of the key, or nullptr. One slot is probed.
+    template<class Q>
+    const V *find(const Q &key) const;
+
+    template<class Q>
+    bool includesKey(const Q &key) const;
+
+    int getCount() const;
+
+    // Bits of the hash function (pilots, remap and partition headers) per key, the entries excluded.
+    double getBitsPerKey() const;
+
+    // Calls f(key, value) for every entry, in slot order.
+    template<class F>
+    void forEach(F f) const;
+};
+
+template<class V, class K, class Hash, class Eq>
+template<class It>
+PerfectHashTable<V, K, Hash, Eq>::PerfectHashTable(It first, It last, int threads, const Hash &hash, const Eq &eq)
+        : _hash(hash), _eq(eq) {
+    int n = (int) distance(first, last);
+    auto hashes = new uint64_t[n];
+    auto keys = new const K *[n];
+    auto values = new const V *[n];
+    int i = 0;
+    for (It it = first; it != last; ++it, ++i) {
+        hashes[i] = hashOf(it->first);
+        keys[i] = &it->first;
+        values[i] = &it->second;
+    }
+    try {
+        build(n, hashes, keys, values, threads);
+    } catch (...) {
+        delete[] hashes;
+        delete[] keys;
+        delete[] values;
+        throw;
+    }
+    delete[] hashes;
+    delete[] keys;
+    delete[] values;
+}
+
+template<class V, class K, class Hash, class Eq>
+PerfectHashTable<V, K, Hash, Eq>::PerfectHashTable(int n, const uint64_t *hashes, const K *const *keys,
+                                                   const V *const *values, int threads,
+                                                   const Hash &hash, const Eq &eq) : _hash(hash), _eq(eq) {
+    build(n, hashes, keys, values, threads);
+}
+
+template<class V, class K, class Hash, class Eq>
+PerfectHashTable<V, K, Hash, Eq>::~PerfectHashTable() {
+    for (int i = 0; i < _counter; ++i) _entries[i].~Entry();
+    operator delete(_entries);
+    delete[] _partitions;
+    delete[] _pilots;
+    delete[] _exceptionBuckets;
+    delete[] _exceptionPilots;
+    delete[] _free;
+}
+
+// Skewed bucket mapping: the low 32 bits below PERFECT_DENSE_KEYS pick a dense bucket.
+template<class V, class K, class Hash, class Eq>
+uint32_t PerfectHashTable<V, K, Hash, Eq>::bucketOf(uint64_t mixed, uint32_t buckets) {
+    const uint64_t threshold = (uint64_t) (PERFECT_DENSE_KEYS * 4294967296.0);
+    uint32_t dense = (uint32_t) (buckets * PERFECT_DENSE_BUCKETS);
+    if (dense == 0) dense = 1;
+    uint64_t x = (uint32_t) mixed;
+    if (x < threshold || dense == buckets) return (uint32_t) (x * dense / threshold) % dense;
+    return dense + (uint32_t) ((x - threshold) * (buckets - dense) / (4294967296ULL - threshold));
+}
+
+template<class V, class K, class Hash, class Eq>
+int PerfectHashTable<V, K, Hash, Eq>::slotOf(uint64_t hash) const {
+    if (_counter == 0) return -1;
+    uint64_t mixed = hashMix(hash, PERFECT_BUCKET_SEED);
+    const Partition &p = _partitions[fastRange((uint32_t) (mixed >> 32), (uint32_t) _partitionCount)];
+    if (p._count == 0) return -1;
+
+    uint32_t bucket = p._firstBucket + bucketOf(mixed, p._buckets);
+    uint64_t pilot = _pilots[bucket];
+    if (pilot == PERFECT_PILOT_ESCAPE) {
+        pilot = _exceptionPilots[lower_bound(_exceptionBuckets, _exceptionBuckets + _exceptionCount, bucket)
+                                 - _exceptionBuckets];
+    }
+
+    uint32_t position = positionOf(hash, pilot, p._positions);
+    if (position >= p._count) position = _free[p._free + position - p._count];
+    return (int) (p._base + position);
+}
+
+/**
+ * One partition: keys are indices into hashes. Outputs the pilot of every bucket,
+ * the position of every key and the remap of the positions past n to the free ones.
+ */
+template<class V, class K, class Hash, class Eq>
+void PerfectHashTable<V, K, Hash, Eq>::buildPartition(const uint64_t *hashes, const int *keys, int n,
+                                                      vector<uint32_t> &pilots, vector<uint32_t> &positions,
+                                                      vector<uint32_t> &free) {
+    uint32_t size = (uint32_t) ceil(n / PERFECT_ALPHA);
+    uint32_t buckets = (uint32_t) ceil(PERFECT_BUCKETS_C * n / log2(n > 2 ? n : 2));
+    pilots.assign(buckets, 0);
+    positions.assign(n, 0);
+
+    // Keys grouped by bucket, the buckets ordered by size, largest first.
+    vector<uint32_t> bucketOfKey(n), offsets(buckets + 1, 0), order(n), bucketOrder(buckets);
+    for (int i = 0; i < n; ++i) {
+        bucketOfKey[i] = bucketOf(hashMix(hashes[keys[i]], PERFECT_BUCKET_SEED), buckets);
+        offsets[bucketOfKey[i] + 1]++;
+    }
+    for (uint32_t b = 0; b < buckets; ++b) offsets[b + 1] += offsets[b];
+    vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (int i = 0; i < n; ++i) order[fill[bucketOfKey[i]]++] = i;
+    for (uint32_t b = 0; b < buckets; ++b) bucketOrder[b] = b;
+    stable_sort(bucketOrder.begin(), bucketOrder.end(), [&](uint32_t x, uint32_t y) {
+        return offsets[x + 1] - offsets[x] > offsets[y + 1] - offsets[y];
+    });
+
+    vector<bool> taken(size, false);
+    vector<uint32_t> candidate;
+    for (uint32_t b : bucketOrder) {
+        uint32_t begin = offsets[b], end = offsets[b + 1];
+        if (begin == end) break;
+
+        // Equal hash codes can't be separated by any pilot.
+        for (uint32_t i = begin; i < end; ++i) {
+            for (uint32_t j = begin; j < i; ++j) {
+                if (hashes[keys[order[i]]] == hashes[keys[order[j]]]) throw PerfectHashBuildError();
+            }
+        }
+
+        for (uint32_t pilot = 0;; ++pilot) {
+            if (pilot == PERFECT_MAX_PILOT) throw PerfectHashBuildError();
+            candidate.clear();
+            bool fits = true;
+            for (uint32_t i = begin; i < end && fits; ++i) {
+                uint32_t position = positionOf(hashes[keys[order[i]]], pilot, size);
+                fits = !taken[position] && std::find(candidate.begin(), candidate.end(), position) == candidate.end();
+                candidate.push_back(position);
+            }
+            if (!fits) continue;
+
+            for (uint32_t i = begin; i < end; ++i) {
+                taken[candidate[i - begin]] = true;
+                positions[order[i]] = candidate[i - begin];
+            }
+            pilots[b] = pilot;
+            break;
+        }
+    }
+
+    // Taken positions past n, in order, take the free positions under n, in order.
+    free.assign(size - n, 0);
+    uint32_t next = 0;
+    for (uint32_t position = n; position < size; ++position) {
+        if (!taken[position]) continue;
+        while (taken[next]) next++;
+        free[position - n] = next++;
+    }
+    for (int i = 0; i < n; ++i) {
+        if (positions[i] >= (uint32_t) n) positions[i] = free[positions[i] - n];
+    }
+}
+
+template<class V, class K, class Hash, class Eq>
+void PerfectHashTable<V, K, Hash, Eq>::build(int n, const uint64_t *hashes, const K *const *keys,
+                                             const V *const *values, int threads) {
+    _counter = n;
+    _partitionCount = n / PERFECT_PARTITION_KEYS + 1;
+    _partitions = new Partition[_partitionCount]();
+
+    // Keys grouped by partition.
+    auto offsets = new int[_partitionCount + 1]();
+    auto order = new int[n > 0 ? n : 1];
+    for (int i = 0; i < n; ++i) {
+        offsets[fastRange((uint32_t) (hashMix(hashes[i], PERFECT_BUCKET_SEED) >> 32), _partitionCount) + 1]++;
+    }
+    for (int p = 0; p < _partitionCount; ++p) offsets[p + 1] += offsets[p];
+    {
+        vector<int> fill(offsets, offsets + _partitionCount);
+        for (int i = 0; i < n; ++i) {
+            order[fill[fastRange((uint32_t) (hashMix(hashes[i], PERFECT_BUCKET_SEED) >> 32), _partitionCount)]++] = i;
+        }
+    }
+
+    vector<vector<uint32_t>> pilots(_partitionCount), positions(_partitionCount), free(_partitionCount);
+    atomic<int> nextPartition(0);
+    atomic<bool> failed(false);
+    auto worker = [&]() {
+        for (int p = nextPartition++; p < _partitionCount && !failed; p = nextPartition++) {
+            try {
+                buildPartition(hashes, order + offsets[p], offsets[p + 1] - offsets[p], pilots[p], positions[p], free[p]);
+            } catch (...) {
+                failed = true;
+            }
+        }
+    };
+    if (threads <= 0) threads = (int) thread::hardware_concurrency();
+    if (threads > _partitionCount) threads = _partitionCount;
+    vector<thread> pool;
+    for (int t = 1; t < threads; ++t) pool.emplace_back(worker);
+    worker();
+    for (auto &t : pool) t.join();
+
+    if (failed) {
+        delete[] offsets;
+        delete[] order;
+        delete[] _partitions;
+        throw PerfectHashBuildError();
+    }
+
+    // Partition headers, pilots, exceptions and the remaps.
+    _bucketCount = 0;
+    _freeCount = 0;
+    _exceptionCount = 0;
+    for (int p = 0; p < _partitionCount; ++p) {
+        auto &partition = _partitions[p];
+        partition._firstBucket = (uint32_t) _bucketCount;
+        partition._base = (uint32_t) offsets[p];
+        partition._count = (uint32_t) (offsets[p + 1] - offsets[p]);
+        partition._positions = (uint32_t) (partition._count + free[p].size());
+        partition._buckets = (uint32_t) pilots[p].size();
+        partition._free = (uint32_t) _freeCount;
+        _bucketCount += (long) pilots[p].size();
+        _freeCount += (long) free[p].size();
+        for (uint32_t pilot : pilots[p]) _exceptionCount += pilot >= PERFECT_PILOT_ESCAPE;
+    }
+    _pilots = new unsigned char[_bucketCount > 0 ? _bucketCount : 1];
+    _exceptionBuckets = new uint32_t[_exceptionCount > 0 ? _exceptionCount : 1];
+    _exceptionPilots = new uint32_t[_exceptionCount > 0 ? _exceptionCount : 1];
+    _free = new uint32_t[_freeCount > 0 ? _freeCount : 1];
+    int exception = 0;
+    for (int p = 0; p < _partitionCount; ++p) {
+        auto &partition = _partitions[p];
+        for (uint32_t b = 0; b < (uint32_t) pilots[p].size(); ++b) {
+            uint32_t pilot = pilots[p][b];
+            _pilots[partition._firstBucket + b] = (unsigned char) (pilot < PERFECT_PILOT_ESCAPE ? pilot : PERFECT_PILOT_ESCAPE);
+            if (pilot >= PERFECT_PILOT_ESCAPE) {
+                _exceptionBuckets[exception] = partition._firstBucket + b;
+                _exceptionPilots[exception++] = pilot;
+            }
+        }
+        copy(free[p].begin(), free[p].end(), _free + partition._free);
+    }
+
+    _entries = static_cast<Entry *>(operator new(sizeof(Entry) * (n > 0 ? n : 1)));
+    for (int p = 0; p < _partitionCount; ++p) {
+        for (int i = 0; i < (int) positions[p].size(); ++i) {
+            int key = order[offsets[p] + i];
+            new(&_entries[offsets[p] + positions[p][i]]) Entry{*keys[key], *values[key]};
+        }
+    }
+    delete[] offsets;
+    delete[] order;
+}
+
+template<class V, class K, class Hash, class Eq>
+template<class Q>
+const V *PerfectHashTable<V, K, Hash, Eq>::find(const Q &key) const {
+    int slot = slotOf(hashOf(key));
+    if (slot < 0 || !_eq(_entries[slot]._key, key)) return nullptr;
+    return &_entries[slot]._value;
+}
+
+template<class V, class K, class Hash, class Eq>
+template<class Q>
+V PerfectHashTable<V, K, Hash, Eq>::getValue(const Q &key) const {
+    auto value = find(key);
+    if (!value) throw HashKeyDoesNotExist();
+    return *value;
+}
+
+template<class V, class K, class Hash, class Eq>
+template<class Q>
+bool PerfectHashTable<V, K, Hash, Eq>::includesKey(const Q &key) const {
+    return find(key) != nullptr;
+}
+
+template<class V, class K, class Hash, class Eq>
+int PerfectHashTable<V, K, Hash, Eq>::getCount() const {
+    return _counter;
+}
+
+template<class V, class K, class Hash, class Eq>
+double PerfectHashTable<V, K, Hash, Eq>::getBitsPerKey() const {
+    if (_counter == 0) return 0;
+    double bits = 8.0 * ((double) _bucketCount + (double) _exceptionCount * 2 * sizeof(uint32_t)
+                         + (double) _freeCount * sizeof(uint32_t) + (double) _partitionCount * sizeof(Partition));
+    return bits / _counter;
+}
+
+template<class V, class K, class Hash, class Eq>
+template<class F>
+void PerfectHashTable<V, K, Hash, Eq>::forEach(F f) const {
+    for (int i = 0; i < _counter; ++i) f(_entries[i]._key, _entries[i]._value);
+}
+
+// Declared in HashTable, defined here so HashTable.hpp doesn't depend on this header.
+template<class V, class K, class Hash, class Eq, int Inline>
+PerfectHashTable<V, K, Hash, Eq> *HashTable<V, K, Hash, Eq, Inline>::buildPerfect(int threads) {
+    auto hashes = new uint64_t[_counter > 0 ? _counter : 1];
+    auto keys = new const K *[_counter > 0 ? _counter : 1];
+    auto values = new const V *[_counter > 0 ? _counter : 1];
+    int n = 0;
+
+    // Hashed entries reuse their cached hash code.
+    for (int t = 0; t < 2; ++t) {
+        auto array = t == 0 ? _hashTable : _oldTable;
+        int size = t == 0 ? _size : _oldSize;
+        for (int i = t == 0 ? 0 : _migrated; i < size; ++i) {
+            if (!array[i]) continue;
+            for (auto it = array[i]->begin(); it != array[i]->end(); ++it) {
+                for (Node *node = it.value(); node; node = node->_next, ++n) {
+                    hashes[n] = it.key();
+                    keys[n] = &node->_key;
+                    values[n] = &node->_value;
+                }
+            }
+        }
+    }
+    for (int i = 0; i < _inlineCount; ++i, ++n) {
+        hashes[n] = hashOf(inlineKeys()[i]);
+        keys[n] = &inlineKeys()[i];
+        values[n] = &inlineValues()[i];
+    }
+
+    PerfectHashTable<V, K, Hash, Eq> *table;
+    try {
+        table = new PerfectHashTable<V, K, Hash, Eq>(n, hashes, keys, values, threads, _hash, _eq);
+    } catch (...) {
+        delete[] hashes;
+        delete[] keys;
+        delete[] values;
+        throw;
+    }
+    delete[] hashes;
+    delete[] keys;
+    delete[] values;
+    return table;
+}
+
+#endif /* PerfectHashTable_H_ */
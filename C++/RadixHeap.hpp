@@ -0,0 +1,114 @@
+#ifndef RADIXHEAP_H
+#define RADIXHEAP_H
+
+#include<stdint.h>
+#include<type_traits>
+#include<utility>
+#include<vector>
+#include "MinHeap.hpp"
+
+/**
+ * Monotone priority queue for unsigned integer keys: a key inserted is never smaller than
+ * the last minimum extracted (simulation clocks, Dijkstra with integer weights).
+ * Bucket 0 holds the keys equal to the last minimum, bucket b the keys whose highest bit
+ * differing from it is bit b - 1. When bucket 0 runs out, the smallest key of the first
+ * non empty bucket becomes the last minimum and that bucket is spread over lower buckets.
+ * A key only moves down, at most once per bit: O(log C) amortized per key, no compares
+ * between entries on insert.
+ * get_min only peeks, the last minimum moves on remove_min/extract_min alone.
+ */
+template<class K = uint32_t, class V = int>
+class RadixHeap {
+    static_assert(is_unsigned<K>::value, "RadixHeap keys are unsigned integers");
+
+    static constexpr int BUCKETS = sizeof(K) * 8 + 1;
+
+    vector<pair<K, V>> buckets[BUCKETS];
+    K last;
+    int size;
+private:
+
+    int bucket_of(K key) {
+        K diff = key ^ last;
+        if (diff == 0) { return 0; }
+        return BUCKETS - 1 - (sizeof(K) > 4 ? __builtin_clzll((unsigned long long) diff)
+                                            : __builtin_clz((unsigned int) diff) - (32 - (int) sizeof(K) * 8));
+    }
+
+    // First non empty bucket past bucket 0, the heap isn't empty and bucket 0 is.
+    int first_bucket() {
+        int b = 1;
+        while (buckets[b].empty()) { b++; }
+        return b;
+    }
+
+    static K min_key(const vector<pair<K, V>> &bucket) {
+        K min = bucket[0].first;
+        for (auto &entry : bucket) {
+            if (entry.first < min) { min = entry.first; }
+        }
+        return min;
+    }
+
+    // Refills bucket 0 from the first non empty bucket, the heap isn't empty.
+    void pull() {
+        if (!buckets[0].empty()) { return; }
+        auto &from = buckets[first_bucket()];
+        last = min_key(from);
+        for (auto &entry : from) {
+            buckets[bucket_of(entry.first)].push_back(std::move(entry));
+        }
+        from.clear();
+    }
+
+public:
+
+    RadixHeap() : last(0), size(0) {}
+
+    int getSize() { return size; }
+
+    bool isEmpty() { return size <= 0; }
+
+    // Throws HeapIllegalInput when key is smaller than the last extracted minimum.
+    void insert(K key, const V& value) {
+        if (key < last) { throw HeapIllegalInput(); }
+        buckets[bucket_of(key)].emplace_back(key, value);
+        size++;
+    }
+
+    // Scans the first non empty bucket when bucket 0 is empty, keys may still be inserted down to the last extracted one.
+    K get_min() {
+        if (size <= 0)
+            throw HeapIsEmpty();
+        if (!buckets[0].empty()) { return last; }
+        return min_key(buckets[first_bucket()]);
+    }
+
+    void remove_min() {
+        if (size <= 0)
+            throw HeapIsEmpty();
+        pull();
+        buckets[0].pop_back();
+        size--;
+    }
+
+    // Removes an entry with the minimal key and returns it.
+    pair<K, V> extract_min() {
+        if (size <= 0)
+            throw HeapIsEmpty();
+        pull();
+        pair<K, V> entry = std::move(buckets[0].back());
+        buckets[0].pop_back();
+        size--;
+        return entry;
+    }
+
+    // Removes all the entries, the next keys may start again from 0.
+    void clear() {
+        for (auto &bucket : buckets) { bucket.clear(); }
+        last = 0;
+        size = 0;
+    }
+};
+
+#endif //RADIXHEAP_H
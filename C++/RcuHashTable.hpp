@@ -0,0 +1,317 @@
+#ifndef RcuHashTable_H_
+#define RcuHashTable_H_
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "HashTable.hpp"
+
+#define RCU_MAX_READERS 256
+#define RCU_IDLE 0
+
+class RcuTooManyReaders : public exception {
+};
+
+/**
+ * Epoch based reclamation shared by all the RcuHashTables.
+ * Every reader thread owns a cache line with the epoch it entered at (0 when outside),
+ * a writer frees a retired pointer only once every active reader entered after it was retired.
+ */
+class EpochDomain {
+private:
+    struct alignas(64) ReaderSlot {
+        atomic<uint64_t> _epoch;
+        atomic<bool> _taken;
+    };
+
+    struct Registration {
+        int _slot = -1;
+        int _depth = 0;
+
+        ~Registration() {
+            if (_slot >= 0) slots()[_slot]._taken.store(false);
+        }
+    };
+
+    static ReaderSlot *slots() {
+        static ReaderSlot readers[RCU_MAX_READERS];
+        return readers;
+    }
+
+    static Registration &registration() {
+        thread_local Registration reg;
+        if (reg._slot < 0) {
+            for (int i = 0; i < RCU_MAX_READERS; ++i) {
+                bool expected = false;
+                if (slots()[i]._taken.compare_exchange_strong(expected, true)) {
+                    reg._slot = i;
+                    break;
+                }
+            }
+            if (reg._slot < 0) throw RcuTooManyReaders();
+        }
+        return reg;
+    }
+
+public:
+    static atomic<uint64_t> &epoch() {
+        static atomic<uint64_t> global(1);
+        return global;
+    }
+
+    static void enter() {
+        auto &reg = registration();
+        if (reg._depth++ == 0) {
+            slots()[reg._slot]._epoch.store(epoch().load());
+            // Publish the epoch before reading any table pointer, pairs with the writer's retire/scan.
+            atomic_thread_fence(memory_order_seq_cst);
+        }
+    }
+
+    static void exit() {
+        auto &reg = registration();
+        if (--reg._depth == 0) slots()[reg._slot]._epoch.store(RCU_IDLE);
+    }
+
+    // Oldest epoch any reader is still in, or UINT64_MAX when there are none.
+    static uint64_t oldestReader() {
+        uint64_t oldest = UINT64_MAX;
+        for (int i = 0; i < RCU_MAX_READERS; ++i) {
+            uint64_t e = slots()[i]._epoch.load();
+            if (e != RCU_IDLE && e < oldest) oldest = e;
+        }
+        return oldest;
+    }
+
+    class ReadGuard {
+    public:
+        ReadGuard() { enter(); }
+
+        ~ReadGuard() { exit(); }
+
+        ReadGuard(const ReadGuard &) = delete;
+
+        ReadGuard &operator=(const ReadGuard &) = delete;
+    };
+};
+
+/**
+ * Hash table with wait-free readers.
+ * getValue/includesKey take no lock and only write the thread's own epoch slot,
+ * writers are serialized by a mutex and publish with atomic slot stores.
+ *
+ * Open addressing with linear probing over atomic entry pointers.
+ * Removed entries become tombstones, a resize builds a new table and swaps it
+ * atomically; removed entries and old tables are freed through the EpochDomain.
+ */
+template<class V>
+class RcuHashTable {
+private:
+    struct Entry {
+        int _key;
+        V _value;
+
+        Entry(int key, const V &value) : _key(key), _value(value) {}
+    };
+
+    struct Table {
+        int _size;
+        atomic<Entry *> *_slots;
+
+        explicit Table(int size) : _size(size), _slots(new atomic<Entry *>[size]) {
+            for (int i = 0; i < size; ++i) _slots[i].store(nullptr, memory_order_relaxed);
+        }
+
+        ~Table() { delete[] _slots; }
+    };
+
+    struct Retired {
+        uint64_t _epoch;
+        Entry *_entry;
+        Table *_table;
+    };
+
+    atomic<Table *> _table;
+    mutex _writeLock;
+    int _counter;
+    int _used;
+    vector<Retired> _retired;
+
+    static Entry *tombstone() { return reinterpret_cast<Entry *>(uintptr_t(1)); }
+
+    static uint64_t mix(int key) { return ((uint32_t) key * 0x9E3779B97F4A7C15ULL) >> 17; }
+
+    static Entry *lookup(Table *table, int key);
+
+    int findSlot(Table *table, int key);
+
+    void rebuild(int size);
+
+    void retire(Entry *entry, Table *table);
+
+    void reclaim();
+
+public:
+    explicit RcuHashTable(int initial_size = 8);
+
+    RcuHashTable(const RcuHashTable &) = delete;
+
+    RcuHashTable &operator=(const RcuHashTable &) = delete;
+
+    ~RcuHashTable();
+
+    V getValue(int key);
+
+    bool includesKey(int key);
+
+    void insert(int key, V value);
+
+    void remove(int key);
+
+    int getCount();
+};
+
+template<class V>
+RcuHashTable<V>::RcuHashTable(int initial_size) : _counter(EMPTY_SIZE), _used(EMPTY_SIZE) {
+    int size = 8;
+    while (size < initial_size * 2) size *= 2;
+    _table.store(new Table(size));
+}
+
+// No reader may be inside the table while it is destroyed.
+template<class V>
+RcuHashTable<V>::~RcuHashTable() {
+    auto table = _table.load();
+    for (int i = 0; i < table->_size; ++i) {
+        auto entry = table->_slots[i].load();
+        if (entry != nullptr && entry != tombstone()) delete entry;
+    }
+    delete table;
+    for (auto &r : _retired) {
+        delete r._entry;
+        delete r._table;
+    }
+}
+
+template<class V>
+typename RcuHashTable<V>::Entry *RcuHashTable<V>::lookup(Table *table, int key) {
+    int mask = table->_size - 1;
+    for (int i = (int) (mix(key) & mask), probes = 0; probes < table->_size; i = (i + 1) & mask, ++probes) {
+        auto entry = table->_slots[i].load(memory_order_acquire);
+        if (entry == nullptr) return nullptr;
+        if (entry != tombstone() && entry->_key == key) return entry;
+    }
+    return nullptr;
+}
+
+template<class V>
+V RcuHashTable<V>::getValue(int key) {
+    EpochDomain::ReadGuard guard;
+    auto entry = lookup(_table.load(memory_order_acquire), key);
+    if (!entry) throw HashKeyDoesNotExist();
+    return entry->_value;
+}
+
+template<class V>
+bool RcuHashTable<V>::includesKey(int key) {
+    EpochDomain::ReadGuard guard;
+    return lookup(_table.load(memory_order_acquire), key) != nullptr;
+}
+
+// Writer side, slot of the key or -1.
+template<class V>
+int RcuHashTable<V>::findSlot(Table *table, int key) {
+    int mask = table->_size - 1;
+    for (int i = (int) (mix(key) & mask), probes = 0; probes < table->_size; i = (i + 1) & mask, ++probes) {
+        auto entry = table->_slots[i].load(memory_order_relaxed);
+        if (entry == nullptr) return -1;
+        if (entry != tombstone() && entry->_key == key) return i;
+    }
+    return -1;
+}
+
+// Copies the live entries to a new table (dropping tombstones) and swaps it in.
+template<class V>
+void RcuHashTable<V>::rebuild(int size) {
+    auto prev = _table.load(memory_order_relaxed);
+    auto next = new Table(size);
+    int mask = size - 1;
+
+    for (int i = 0; i < prev->_size; ++i) {
+        auto entry = prev->_slots[i].load(memory_order_relaxed);
+        if (entry == nullptr || entry == tombstone()) continue;
+        int j = (int) (mix(entry->_key) & mask);
+        while (next->_slots[j].load(memory_order_relaxed) != nullptr) j = (j + 1) & mask;
+        next->_slots[j].store(entry, memory_order_relaxed);
+    }
+    _used = _counter;
+    _table.store(next, memory_order_release);
+    retire(nullptr, prev);
+}
+
+template<class V>
+void RcuHashTable<V>::insert(int key, V value) {
+    lock_guard<mutex> lock(_writeLock);
+    auto table = _table.load(memory_order_relaxed);
+    if (findSlot(table, key) >= 0) throw AvlKeyAlreadyExists();
+
+    if ((_used + 1) * 4 > table->_size * 3) {
+        rebuild((_counter + 1) * 2 > table->_size ? table->_size * 2 : table->_size);
+        table = _table.load(memory_order_relaxed);
+    }
+
+    auto entry = new Entry(key, value);
+    int mask = table->_size - 1;
+    int i = (int) (mix(key) & mask);
+    while (table->_slots[i].load(memory_order_relaxed) != nullptr) i = (i + 1) & mask;
+
+    table->_slots[i].store(entry, memory_order_release);
+    _counter++;
+    _used++;
+    reclaim();
+}
+
+template<class V>
+void RcuHashTable<V>::remove(int key) {
+    lock_guard<mutex> lock(_writeLock);
+    auto table = _table.load(memory_order_relaxed);
+    int i = findSlot(table, key);
+    if (i < 0) return;
+
+    auto entry = table->_slots[i].load(memory_order_relaxed);
+    table->_slots[i].store(tombstone(), memory_order_release);
+    _counter--;
+    retire(entry, nullptr);
+    reclaim();
+}
+
+template<class V>
+void RcuHashTable<V>::retire(Entry *entry, Table *table) {
+    _retired.push_back(Retired{EpochDomain::epoch().fetch_add(1), entry, table});
+}
+
+template<class V>
+void RcuHashTable<V>::reclaim() {
+    if (_retired.empty()) return;
+    uint64_t oldest = EpochDomain::oldestReader();
+
+    size_t kept = 0;
+    for (size_t i = 0; i < _retired.size(); ++i) {
+        if (_retired[i]._epoch < oldest) {
+            delete _retired[i]._entry;
+            delete _retired[i]._table;
+        } else {
+            _retired[kept++] = _retired[i];
+        }
+    }
+    _retired.resize(kept);
+}
+
+template<class V>
+int RcuHashTable<V>::getCount() {
+    lock_guard<mutex> lock(_writeLock);
+    return _counter;
+}
+
+#endif /* RcuHashTable_H_ */
@@ -0,0 +1,100 @@
+#ifndef TOPK_H
+#define TOPK_H
+
+#include<algorithm>
+#include<functional>
+#include<type_traits>
+#include<vector>
+#include "MinHeap.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * The k largest items (by Compare) of a stream, kept in a MinHeap of size k whose
+ * minimum is the admission threshold. An item is rejected with one compare, or replaces
+ * the minimum with a single sift down.
+ * offerBatch compares int items 8 at a time against the threshold (SSE2) and only
+ * offers the ones above it, most items of a long stream are rejected there.
+ */
+template<class T = int, class Compare = less<T>>
+class TopK {
+    MinHeap<T, Compare> heap;
+    int k;
+    Compare compare;
+private:
+
+    static constexpr bool simd_batch = is_same<T, int>::value &&
+                                       (is_same<Compare, less<int>>::value || is_same<Compare, less<>>::value);
+
+    template<class U>
+    bool admit(U&& x) {
+        if (heap.getSize() < k) {
+            heap.emplace(std::forward<U>(x));
+            return true;
+        }
+        if (!compare(heap.get_min(), x)) { return false; }
+        heap.replace_min(std::forward<U>(x));
+        return true;
+    }
+
+public:
+
+    explicit TopK(int k, const Compare &compare = Compare()) : heap(k > 0 ? k : 1, compare), k(k), compare(compare) {
+        if (k <= 0) { throw HeapIllegalInput(); }
+    }
+
+    int getSize() { return heap.getSize(); }
+
+    // The smallest of the kept items, an item has to beat it once k are kept.
+    const T& get_min() { return heap.get_min(); }
+
+    // @return true when the item is kept (for now).
+    bool offer(const T& x) { return admit(x); }
+
+    // Moves the item in when it's kept, a rejected item isn't touched.
+    bool offer(T&& x) { return admit(std::move(x)); }
+
+    void offerBatch(const T* items, int n) {
+        int i = 0;
+        for (; i < n && heap.getSize() < k; ++i) {
+            heap.insert(items[i]);
+        }
+#ifdef __SSE2__
+        // The heap is full unless the items ran out.
+        if constexpr (simd_batch) {
+            if (i == n) { return; }
+            __m128i threshold = _mm_set1_epi32(heap.get_min());
+            for (; i + 8 <= n; i += 8) {
+                __m128i a = _mm_loadu_si128((const __m128i*) (items + i));
+                __m128i b = _mm_loadu_si128((const __m128i*) (items + i + 4));
+                int mask = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(a, threshold))) |
+                           _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpgt_epi32(b, threshold))) << 4;
+                if (mask == 0) { continue; }
+                while (mask) {
+                    offer(items[i + __builtin_ctz(mask)]);
+                    mask &= mask - 1;
+                }
+                threshold = _mm_set1_epi32(heap.get_min());
+            }
+        }
+#endif
+        for (; i < n; ++i) {
+            offer(items[i]);
+        }
+    }
+
+    // Removes and returns the kept items, largest first.
+    vector<T> drainSorted() {
+        vector<T> items;
+        items.reserve(heap.getSize());
+        while (!heap.isEmpty()) {
+            items.push_back(heap.pop());
+        }
+        reverse(items.begin(), items.end());
+        return items;
+    }
+};
+
+#endif //TOPK_H
@@ -0,0 +1,133 @@
+// g++ -std=c++17 -fsanitize=address,undefined MappedHashTableTest.cpp -o MappedHashTableTest && ./MappedHashTableTest
+
+#include <assert.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <vector>
+#include "../MappedHashTable.hpp"
+
+static const char *IMAGE = "MappedHashTableTest.image";
+
+struct Point {
+    int x;
+    int y;
+};
+
+static HashTable<Point>::ValueDestroyFunction keepValues;
+
+static vector<char> readImage() {
+    FILE *file = fopen(IMAGE, "rb");
+    assert(file);
+    vector<char> bytes;
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) bytes.insert(bytes.end(), buffer, buffer + n);
+    fclose(file);
+    return bytes;
+}
+
+static void writeImage(const vector<char> &bytes) {
+    FILE *file = fopen(IMAGE, "wb");
+    assert(file);
+    size_t written = fwrite(bytes.data(), 1, bytes.size(), file);
+    assert(written == bytes.size());
+    fclose(file);
+}
+
+static bool rejected() {
+    try {
+        MappedHashTable<Point> table(IMAGE);
+        return false;
+    } catch (HashImageError &) {
+        return true;
+    }
+}
+
+template<class T>
+static void corrupt(const vector<char> &image, size_t offset, T value) {
+    vector<char> bytes = image;
+    memcpy(bytes.data() + offset, &value, sizeof(value));
+    writeImage(bytes);
+    bool loadFailed = rejected();
+    assert(loadFailed);
+}
+
+static void testRoundTrip() {
+    HashTable<Point> table;
+    for (int i = 0; i < 10000; ++i) table.insert(i * 7, Point{i, -i});
+    table.exportImage(IMAGE);
+    table.destroyHash(&keepValues);
+
+    MappedHashTable<Point> mapped(IMAGE);
+    assert(mapped.getCount() == 10000);
+    for (int i = 0; i < 10000; ++i) {
+        assert(mapped.includesKey(i * 7));
+        assert(mapped.getValue(i * 7).x == i && mapped.find(i * 7)->y == -i);
+    }
+    assert(!mapped.includesKey(1) && mapped.find(3) == nullptr);
+    bool thrown = false;
+    try {
+        mapped.getValue(1);
+    } catch (HashKeyDoesNotExist &) {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+static void testEmpty() {
+    HashTable<Point> table;
+    table.exportImage(IMAGE);
+    table.destroyHash(&keepValues);
+    MappedHashTable<Point> mapped(IMAGE);
+    assert(mapped.getCount() == 0 && !mapped.includesKey(0));
+}
+
+static void testCorruptImages() {
+    HashTable<Point> table;
+    for (int i = 0; i < 100; ++i) table.insert(i, Point{i, i});
+    table.exportImage(IMAGE);
+    table.destroyHash(&keepValues);
+    const vector<char> image = readImage();
+    HashImageHeader header;
+    memcpy(&header, image.data(), sizeof(header));
+
+    // Missing and truncated files.
+    remove(IMAGE);
+    bool missing = rejected();
+    writeImage(vector<char>(image.begin(), image.begin() + sizeof(HashImageHeader) - 1));
+    bool shortHeader = rejected();
+    writeImage(vector<char>(image.begin(), image.end() - 1));
+    bool shortData = rejected();
+    assert(missing && shortHeader && shortData);
+
+    corrupt(image, offsetof(HashImageHeader, _magic), 'X');
+    corrupt(image, offsetof(HashImageHeader, _version), (uint32_t) HASH_IMAGE_VERSION + 1);
+    corrupt(image, offsetof(HashImageHeader, _valueSize), (uint32_t) sizeof(Point) + 1);
+    corrupt(image, offsetof(HashImageHeader, _capacity), (uint64_t) 0);
+    corrupt(image, offsetof(HashImageHeader, _capacity), header._capacity + 1);
+    corrupt(image, offsetof(HashImageHeader, _count), header._capacity);
+    // Sums that wrap around 2^64 when added unchecked.
+    corrupt(image, offsetof(HashImageHeader, _capacity), (uint64_t) 1 << 61);
+    corrupt(image, offsetof(HashImageHeader, _slotsOffset), ~(uint64_t) 0 - 7);
+    corrupt(image, offsetof(HashImageHeader, _valuesOffset), ~(uint64_t) 0 - 7);
+    corrupt(image, offsetof(HashImageHeader, _slotsOffset), (uint64_t) image.size() + 64);
+    // Overlapping or misaligned sections.
+    corrupt(image, offsetof(HashImageHeader, _slotsOffset), (uint64_t) 0);
+    corrupt(image, offsetof(HashImageHeader, _slotsOffset), header._slotsOffset + 1);
+    corrupt(image, offsetof(HashImageHeader, _valuesOffset), header._slotsOffset);
+    corrupt(image, offsetof(HashImageHeader, _valuesOffset), header._valuesOffset + 1);
+
+    // The untouched image still loads.
+    writeImage(image);
+    bool loadFailed = rejected();
+    assert(!loadFailed);
+}
+
+int main() {
+    testRoundTrip();
+    testEmpty();
+    testCorruptImages();
+    remove(IMAGE);
+    printf("MappedHashTableTest passed\n");
+    return 0;
+}
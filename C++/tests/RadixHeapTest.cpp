@@ -0,0 +1,94 @@
+// g++ -std=c++17 -fsanitize=address,undefined RadixHeapTest.cpp -o RadixHeapTest && ./RadixHeapTest
+
+#include <assert.h>
+#include <stdio.h>
+#include <queue>
+#include <random>
+#include "../RadixHeap.hpp"
+
+// get_min doesn't move the last minimum: keys between the last extracted one and the peeked one are accepted.
+static void testPeekThenInsert() {
+    RadixHeap<uint32_t, int> heap;
+    heap.insert(5, 0);
+    heap.insert(10, 1);
+    auto first = heap.extract_min();
+    assert(first.first == 5);
+
+    assert(heap.get_min() == 10);
+    heap.insert(7, 2);
+    assert(heap.get_min() == 7);
+    heap.insert(5, 3);
+
+    auto a = heap.extract_min();
+    auto b = heap.extract_min();
+    auto c = heap.extract_min();
+    assert(a == make_pair(5u, 3) && b == make_pair(7u, 2) && c == make_pair(10u, 1));
+    assert(heap.isEmpty());
+}
+
+static void testBelowLastExtracted() {
+    RadixHeap<uint32_t, int> heap;
+    heap.insert(3, 0);
+    heap.insert(8, 1);
+    heap.remove_min();
+    bool thrown = false;
+    try {
+        heap.insert(2, 2);
+    } catch (HeapIllegalInput &) {
+        thrown = true;
+    }
+    assert(thrown);
+    assert(heap.getSize() == 1);
+}
+
+static void testEmpty() {
+    RadixHeap<uint32_t, int> heap;
+    bool thrown = false;
+    try {
+        heap.get_min();
+    } catch (HeapIsEmpty &) {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+// Random monotone inserts, peeks and extractions against std::priority_queue.
+template<class K>
+static void testAgainstPriorityQueue(K range) {
+    mt19937_64 rng(7);
+    RadixHeap<K, int> heap;
+    priority_queue<K, vector<K>, greater<K>> expected;
+    K last = 0;
+    for (int i = 0; i < 100000; ++i) {
+        if (rng() % 2 && !expected.empty()) {
+            assert(heap.get_min() == expected.top());
+            auto entry = heap.extract_min();
+            assert(entry.first == expected.top());
+            last = entry.first;
+            expected.pop();
+        } else {
+            K key = last + (K) (rng() % range);
+            if (key < last) key = last;
+            heap.insert(key, i);
+            expected.push(key);
+        }
+        assert(heap.getSize() == (int) expected.size());
+    }
+    while (!expected.empty()) {
+        auto entry = heap.extract_min();
+        assert(entry.first == expected.top());
+        expected.pop();
+    }
+    assert(heap.isEmpty());
+}
+
+int main() {
+    testPeekThenInsert();
+    testBelowLastExtracted();
+    testEmpty();
+    testAgainstPriorityQueue<uint32_t>(1000);
+    testAgainstPriorityQueue<uint64_t>(1ULL << 40);
+    testAgainstPriorityQueue<uint8_t>(3);
+    printf("RadixHeapTest passed\n");
+    return 0;
+}